@@ -1,9 +1,18 @@
 #include "AlignmentResult.hpp"
 
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
 #include <pbcopper/utility/SequenceUtils.h>
 #include "AlignerUtils.hpp"
 
+#include <htslib/sam.h>
+#include <boost/algorithm/string.hpp>
+
+#include <algorithm>
+#include <cassert>
 #include <cstddef>
+#include <cstring>
+#include <limits>
 #include <ostream>
 #include <stdexcept>
 #include <tuple>
@@ -155,13 +164,115 @@ std::ostream& operator<<(std::ostream& out, const AlignmentResult& a)
     return out;
 }
 
+void DecodeSequence(const BAM::BamRecord& record, const int32_t start, const int32_t end,
+                    std::string& sequence)
+{
+    const auto& raw = record.Impl().RawData();
+    const bam1_t* b = &*raw;
+    assert(start >= 0 && start <= end && end <= b->core.l_qseq);
+    const uint8_t* encoded = bam_get_seq(b);
+    sequence.resize(end - start);
+    for (int32_t i = start; i < end; ++i) {
+        sequence[i - start] = seq_nt16_str[bam_seqi(encoded, i)];
+    }
+}
+
+TagFilter ParseTagFilter(const std::string& keepTags, const std::string& dropTags,
+                         const bool stripKinetics)
+{
+    const auto split = [](const std::string& tags) {
+        std::vector<std::string> result;
+        if (tags.empty()) {
+            return result;
+        }
+        boost::split(result, tags, boost::is_any_of(","));
+        for (const auto& tag : result) {
+            if (tag.size() != 2) {
+                throw PB_CLI_ALARM("Tag names must have two characters: '" + tag + '\'');
+            }
+        }
+        return result;
+    };
+
+    TagFilter filter;
+    filter.Drop = split(dropTags);
+    if (!keepTags.empty()) {
+        if (!filter.Drop.empty()) {
+            throw PB_CLI_ALARM("--keep-tags and --drop-tags are mutually exclusive");
+        }
+        filter.Keep = split(keepTags);
+    }
+    if (stripKinetics) {
+        for (const char* tag : {"ip", "pw", "fi", "ri", "fp", "rp", "fn", "rn"}) {
+            filter.Drop.emplace_back(tag);
+        }
+    }
+    // Kinetics are stripped from a keep list as well
+    if (filter.Keep) {
+        std::erase_if(*filter.Keep, [&filter](const std::string& tag) {
+            return std::find(filter.Drop.cbegin(), filter.Drop.cend(), tag) != filter.Drop.cend();
+        });
+    }
+
+    // Read group, ZMW and query coordinates define the record, clipping needs them
+    for (const char* tag : {"RG", "zm", "qs", "qe"}) {
+        if (std::erase(filter.Drop, tag) > 0) {
+            PBLOG_BLOCK_WARN("Tags", std::string{"Required tag "} + tag + " is always kept");
+        }
+        if (filter.Keep &&
+            std::find(filter.Keep->cbegin(), filter.Keep->cend(), tag) == filter.Keep->cend()) {
+            filter.Keep->emplace_back(tag);
+        }
+    }
+    return filter;
+}
+
+namespace {
+
+// Appends the aux block of source unchanged and deletes the dropped tags in
+// place, no tag value is decoded
+void CopyRawTags(const bam1_t* source, bam1_t* target, const std::vector<std::string>& drop)
+{
+    assert(bam_get_l_aux(target) == 0);
+    const uint8_t* aux = bam_get_aux(source);
+    const std::size_t length = bam_get_l_aux(source);
+    const std::size_t newLength = static_cast<std::size_t>(target->l_data) + length;
+    if (newLength > static_cast<std::size_t>(std::numeric_limits<int>::max()) ||
+        (newLength > target->m_data && sam_realloc_bam_data(target, newLength) < 0)) {
+        throw std::runtime_error{"Could not copy tags of " + std::string{bam_get_qname(source)}};
+    }
+    // The aux block is the last part of the record data
+    std::memcpy(target->data + target->l_data, aux, length);
+    target->l_data = newLength;
+    for (const auto& tag : drop) {
+        if (uint8_t* value = bam_aux_get(target, tag.c_str())) {
+            bam_aux_del(target, value);
+        }
+    }
+}
+
+}  // namespace
+
 BAM::BamRecord AlnToBam(const int32_t refId, const BAM::BamHeader& header,
-                        const AlignmentResult& aln, const BAM::BamRecord& read, const bool ccs)
+                        const AlignmentResult& aln, const BAM::BamRecord& read,
+                        const std::string& sequence, const bool ccs, const TagFilter& tagFilter)
 {
     BAM::BamRecord record{header};
-    record.Impl().SetSequenceAndQualities(read.Sequence());
+    record.Impl().SetSequenceAndQualities(sequence);
     record.Impl().Name(read.FullName());
-    record.Impl().Tags(read.Impl().Tags());
+    if (tagFilter.Keep) {
+        // Only kept tags are decoded, dropped kinetics are never touched
+        for (const auto& tag : *tagFilter.Keep) {
+            if (read.Impl().HasTag(tag)) {
+                record.Impl().AddTag(tag, read.Impl().TagValue(tag));
+            }
+        }
+    } else if (!tagFilter.Drop.empty()) {
+        // Dropped kinetics are deleted as raw bytes, they are never decoded
+        CopyRawTags(read.Impl().RawData().get(), record.Impl().RawData().get(), tagFilter.Drop);
+    } else {
+        record.Impl().Tags(read.Impl().Tags());
+    }
     std::string cigarStr = aln.cigar.ToStdString();
     int clipStart = aln.rReversed ? aln.qLen - aln.qEnd : aln.qStart;
     int clipEnd = aln.rReversed ? aln.qStart : aln.qLen - aln.qEnd;
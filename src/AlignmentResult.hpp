@@ -7,6 +7,9 @@
 #include <cstdint>
 #include <iosfwd>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace PacBio {
 
@@ -46,7 +49,27 @@ std::ostream& operator<<(std::ostream& out, const AlignmentResult& a);
 
 using AlnResults = std::vector<std::unique_ptr<AlignmentResult>>;
 
+// Decodes bases [start, end) of an unaligned record into sequence, reusing its
+// capacity. Trimmed sequences are decoded directly, without an intermediate copy.
+void DecodeSequence(const BAM::BamRecord& record, int32_t start, int32_t end,
+                    std::string& sequence);
+
+// Aux tags copied from the input read to the output record. Without a keep
+// list, all tags except the dropped ones are copied.
+struct TagFilter
+{
+    std::optional<std::vector<std::string>> Keep;
+    std::vector<std::string> Drop;
+};
+
+// Tags from comma-separated lists, stripping kinetics adds ip, pw, fi, ri,
+// fp, rp, fn and rn to the dropped tags
+TagFilter ParseTagFilter(const std::string& keepTags, const std::string& dropTags,
+                         bool stripKinetics);
+
+// The sequence of read is passed already decoded
 BAM::BamRecord AlnToBam(const int32_t refId, const BAM::BamHeader& header,
-                        const AlignmentResult& aln, const BAM::BamRecord& read, bool ccs);
+                        const AlignmentResult& aln, const BAM::BamRecord& read,
+                        const std::string& sequence, bool ccs, const TagFilter& tagFilter);
 
 }  // namespace PacBio
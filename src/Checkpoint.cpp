@@ -0,0 +1,69 @@
+#include "Checkpoint.hpp"
+
+#include <pbcopper/utility/Alarm.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace PacBio {
+namespace {
+
+constexpr char CHECKPOINT_MAGIC[] = "actc-checkpoint";
+constexpr int32_t CHECKPOINT_VERSION = 1;
+
+}  // namespace
+
+std::string Checkpoint::Filename(const std::string& outputFile)
+{
+    return outputFile + ".checkpoint";
+}
+
+std::optional<Checkpoint> Checkpoint::Load(const std::string& filename)
+{
+    std::ifstream in{filename};
+    if (!in) {
+        return std::nullopt;
+    }
+
+    std::string magic;
+    int32_t version = 0;
+    int32_t numFlushes = 0;
+    Checkpoint checkpoint;
+    in >> magic >> version >> checkpoint.Interval >> checkpoint.NumZmwsRead >>
+        checkpoint.NextCcsIdx >> checkpoint.NumZmwsWritten >> checkpoint.NumRecords >> numFlushes;
+    if (!in || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION || numFlushes < 0) {
+        throw PB_CLI_ALARM("Corrupt checkpoint file: " + filename);
+    }
+    checkpoint.FlushedRecords.resize(numFlushes);
+    for (auto& numRecords : checkpoint.FlushedRecords) {
+        in >> numRecords;
+    }
+    if (!in) {
+        throw PB_CLI_ALARM("Corrupt checkpoint file: " + filename);
+    }
+    return checkpoint;
+}
+
+void Checkpoint::Save(const std::string& filename) const
+{
+    const std::string tmpFilename = filename + ".tmp";
+    {
+        std::ofstream out{tmpFilename};
+        out << CHECKPOINT_MAGIC << ' ' << CHECKPOINT_VERSION << '\n'
+            << Interval << ' ' << NumZmwsRead << ' ' << NextCcsIdx << ' ' << NumZmwsWritten << ' '
+            << NumRecords << '\n'
+            << FlushedRecords.size() << '\n';
+        for (const int64_t numRecords : FlushedRecords) {
+            out << numRecords << '\n';
+        }
+        out.flush();
+        if (!out) {
+            throw PB_ALARM("OutputDataError", "Could not write checkpoint file: " + tmpFilename);
+        }
+    }
+    std::filesystem::rename(tmpFilename, filename);
+}
+
+}  // namespace PacBio
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace PacBio {
+
+// Progress of the output BAM, saved every N written ZMWs. All records up to
+// NumRecords have been flushed to disk when the checkpoint is saved.
+struct Checkpoint
+{
+    // ZMWs written between two checkpoints
+    int32_t Interval{0};
+    // CCS ZMWs read from the input, including skipped ones
+    int32_t NumZmwsRead{0};
+    // Reference index of the next CCS record
+    int32_t NextCcsIdx{0};
+    // ZMWs handed to the writer
+    int32_t NumZmwsWritten{0};
+    // Records written to the output BAM
+    int64_t NumRecords{0};
+    // Record counts at which the output BAM was flushed, needed to reproduce
+    // the BGZF block layout on resume
+    std::vector<int64_t> FlushedRecords;
+
+    static std::string Filename(const std::string& outputFile);
+
+    static std::optional<Checkpoint> Load(const std::string& filename);
+
+    // Atomically replaces the checkpoint file
+    void Save(const std::string& filename) const;
+};
+
+}  // namespace PacBio
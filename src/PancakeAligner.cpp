@@ -1,39 +1,220 @@
 #include "PancakeAligner.hpp"
 
-#include <pbbam/BamRecord.h>
+#include "AlignerUtils.hpp"
 
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/SequenceUtils.h>
+#include <pancake/FastaSequenceCached.hpp>
+#include <pancake/FastaSequenceCachedStore.hpp>
+#include <pancake/Minimizers.hpp>
+#include <pancake/SeedIndex.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <compare>
 #include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace PacBio {
+namespace {
 
-std::vector<AlnResults> PancakeAligner(Pancake::MapperCLR& mapper,
-                                       const std::vector<BAM::BamRecord>& reads,
-                                       const std::string& reference)
+// Subreads whose length differs from the CCS by more than this fraction are
+// considered partial passes and do not inform the bandwidth estimate.
+constexpr double FULL_PASS_LENGTH_TOLERANCE = 0.3;
+// Alignments that stop this many bases short of both the query and the
+// reference end are considered truncated by the band or z-drop.
+constexpr int64_t TRUNCATION_SLACK = 50;
+// A primary alignment anchors the strand prediction if it is long and
+// accurate enough, only the first few subreads are tried as anchors.
+constexpr int64_t MIN_STRAND_ANCHOR_SPAN = 500;
+constexpr double MIN_STRAND_ANCHOR_FRACTION = 0.8;
+constexpr double MIN_STRAND_ANCHOR_IDENTITY = 0.7;
+constexpr int32_t MAX_STRAND_ANCHOR_TRIES = 3;
+// Idle mappers kept by the process-wide pool, beyond this returned mappers
+// are destroyed
+constexpr std::size_t MAX_IDLE_MAPPERS = 256;
+// A CCS is low-complexity if fewer than this fraction of its k-mers are
+// distinct. Random sequence is close to 1, a tandem repeat of N copies at 1/N.
+constexpr int32_t COMPLEXITY_KMER_SIZE = 15;
+constexpr double MIN_DISTINCT_KMER_FRACTION = 0.5;
+
+// Every mapper setting of this file is derived from these inputs, so they
+// identify a mapper
+struct MapperVariant
 {
-    if (reads.empty()) {
-        return {};
+    bool ShortInsert{false};
+    int32_t AlignBandwidth{DEFAULT_ALIGN_BANDWIDTH};
+    bool PrimaryOnly{false};
+    bool LowComplexity{false};
+    // Seed the forward orientation of the queries only
+    bool ForwardOnly{false};
+
+    auto operator<=>(const MapperVariant&) const = default;
+};
+
+struct MapperSetup
+{
+    MapperVariant Variant;
+    Pancake::MapperCLRSettings Settings;
+};
+
+// Band and z-drop chosen for a ZMW
+void LogAlignmentBand(const MapperSetup& setup)
+{
+    PBLOG_DEBUG << "Alignment band " << setup.Settings.align.alnParamsGlobal.alignBandwidth
+                << ", z-drop " << setup.Settings.align.alnParamsGlobal.zdrop;
+}
+
+MapperSetup MakeMapperSetup(const MapperVariant& variant)
+{
+    MapperSetup setup{variant,
+                      InitPancakeSettingsSubread(variant.ShortInsert, variant.AlignBandwidth,
+                                                 variant.PrimaryOnly, variant.LowComplexity)};
+    if (variant.ForwardOnly) {
+        setup.Settings.map.seedParams.UseRC = false;
+        setup.Settings.map.seedParamsFallback.UseRC = false;
     }
+    return setup;
+}
 
-    if (reference.empty()) {
-        return {};
+// Constructing a mapper allocates its seed index and aligners. Idle mappers
+// are pooled per variant and outlive the threads that used them, so
+// consecutive runs of one process start warm.
+std::shared_ptr<Pancake::MapperCLR> CachedMapper(const MapperSetup& setup)
+{
+    struct Pool
+    {
+        std::mutex Mutex;
+        std::map<MapperVariant, std::vector<std::unique_ptr<Pancake::MapperCLR>>> Idle;
+        std::size_t NumIdle{0};
+    };
+    static Pool pool;
+
+    const MapperVariant key = setup.Variant;
+    std::unique_ptr<Pancake::MapperCLR> mapper;
+    {
+        std::lock_guard<std::mutex> lock{pool.Mutex};
+        auto it = pool.Idle.find(key);
+        if (it != pool.Idle.end() && !it->second.empty()) {
+            mapper = std::move(it->second.back());
+            it->second.pop_back();
+            --pool.NumIdle;
+        }
+    }
+    if (!mapper) {
+        mapper = std::make_unique<Pancake::MapperCLR>(setup.Settings);
     }
+    return {mapper.release(), [key](Pancake::MapperCLR* released) {
+                std::unique_ptr<Pancake::MapperCLR> owned{released};
+                std::lock_guard<std::mutex> lock{pool.Mutex};
+                if (pool.NumIdle < MAX_IDLE_MAPPERS) {
+                    pool.Idle[key].emplace_back(std::move(owned));
+                    ++pool.NumIdle;
+                }
+            }};
+}
 
-    // Prepare the target for mapping.
-    std::vector<std::string> refs = {reference};
+// Deadline of the ZMW aligned by this thread, see AlignmentDeadline
+thread_local std::optional<std::chrono::steady_clock::time_point> zmwDeadline;
+thread_local bool zmwDeadlineExceeded = false;
+
+// Seed index of one reference, queries are mapped and aligned against it one
+// at a time. Seeding and the frequency cutoff follow MapperCLR::MapAndAlign,
+// which builds the same index for each batch of queries.
+class ReferenceIndex
+{
+public:
+    using Key = std::tuple<int32_t, int32_t, int32_t, bool, bool, int32_t, double>;
 
-    // Prepare the query sequences for mapping.
-    std::vector<std::string> queries;
-    for (const auto& r : reads) {
-        queries.emplace_back(r.Sequence());
+    ReferenceIndex(std::string reference, const Pancake::MapperCLRMapSettings& settings)
+        : reference_{std::move(reference)}, key_{IndexKey(settings)}
+    {
+        targets_.AddRecord(Pancake::FastaSequenceCached{
+            "0", reference_.c_str(), static_cast<int64_t>(reference_.size()), 0});
+        const auto& seedParams = settings.seedParams;
+        std::vector<Pancake::Int128t> seeds;
+        std::vector<int32_t> sequenceLengths;
+        Pancake::GenerateMinimizers(seeds, sequenceLengths, targets_, seedParams.KmerSize,
+                                    seedParams.MinimizerWindow, seedParams.Spacing,
+                                    seedParams.UseRC, seedParams.UseHPCForSeedsOnly,
+                                    seedParams.MaxHPCLen);
+        index_ = std::make_unique<Pancake::SeedIndex>(std::move(seeds));
+        int64_t freqMax = 0;
+        double freqAvg = 0.0;
+        double freqMedian = 0.0;
+        index_->ComputeFrequencyStats(settings.freqPercentile, freqMax, freqAvg, freqMedian,
+                                      freqCutoff_);
     }
 
-    auto mappingResults = mapper.MapAndAlign(refs, queries);
+    static Key IndexKey(const Pancake::MapperCLRMapSettings& settings)
+    {
+        const auto& seedParams = settings.seedParams;
+        return {seedParams.KmerSize,    seedParams.MinimizerWindow,    seedParams.Spacing,
+                seedParams.UseRC,       seedParams.UseHPCForSeedsOnly, seedParams.MaxHPCLen,
+                settings.freqPercentile};
+    }
 
-    std::vector<AlnResults> ret(queries.size());
+    bool Matches(const std::string& reference, const Key& key) const
+    {
+        return key_ == key && reference_ == reference;
+    }
+
+    Pancake::MapperBaseResult MapAndAlign(Pancake::MapperCLR& mapper,
+                                          const Pancake::MapperCLRMapSettings& settings,
+                                          const std::string& query, const int32_t queryId) const
+    {
+        const auto& seedParams = settings.seedParams;
+        std::vector<Pancake::Int128t> querySeeds;
+        const int32_t rv = Pancake::SeedDB::GenerateMinimizers(
+            querySeeds, reinterpret_cast<const uint8_t*>(query.c_str()), query.size(), 0, queryId,
+            seedParams.KmerSize, seedParams.MinimizerWindow, seedParams.Spacing, seedParams.UseRC,
+            seedParams.UseHPCForSeedsOnly, seedParams.MaxHPCLen);
+        if (rv != 0) {
+            throw std::runtime_error{"Could not compute the seeds of subread " +
+                                     std::to_string(queryId)};
+        }
+        const Pancake::FastaSequenceCached querySeq{std::to_string(queryId), query.c_str(),
+                                                    static_cast<int64_t>(query.size()), queryId};
+        return mapper.MapAndAlignSingleQuery(targets_, *index_, querySeq, querySeeds, queryId,
+                                             freqCutoff_);
+    }
+
+private:
+    const std::string reference_;
+    const Key key_;
+    Pancake::FastaSequenceCachedStore targets_;
+    std::unique_ptr<Pancake::SeedIndex> index_;
+    int64_t freqCutoff_{0};
+};
+
+// Indices built for the ZMW under the current deadline, one per reference
+// and seed setting. Cleared with the deadline.
+thread_local std::vector<std::unique_ptr<ReferenceIndex>> zmwReferenceIndices;
 
-    // Convert the results.
+const ReferenceIndex& ZmwReferenceIndex(const std::string& reference,
+                                        const Pancake::MapperCLRMapSettings& settings)
+{
+    const ReferenceIndex::Key key = ReferenceIndex::IndexKey(settings);
+    for (const auto& index : zmwReferenceIndices) {
+        if (index->Matches(reference, key)) {
+            return *index;
+        }
+    }
+    return *zmwReferenceIndices.emplace_back(std::make_unique<ReferenceIndex>(reference, settings));
+}
+
+// Mapping results of queries starting at offset
+void ConvertMappings(auto& mappingResults, const size_t offset, std::vector<AlnResults>& ret)
+{
     for (size_t i = 0; i < mappingResults.size(); ++i) {
         for (size_t j = 0; j < mappingResults[i].mappings.size(); ++j) {
             auto& m = mappingResults[i].mappings[j];
@@ -45,14 +226,161 @@ std::vector<AlnResults> PancakeAligner(Pancake::MapperCLR& mapper,
                 aln->Bid, aln->Brev, aln->BstartFwd(), aln->BendFwd(), aln->Astart, aln->Aend,
                 aln->Alen, std::move(aln->Cigar), 60, aln->Score, true, m->isSupplementary,
                 m->priority > 0);
-            ret[i].emplace_back(std::move(alnResult));
+            ret[offset + i].emplace_back(std::move(alnResult));
         }
     }
+}
+
+// Band of a ZMW, the fallback after an exceeded deadline uses the narrowest
+int32_t ZmwBandwidth(const SubreadAlignerConfig& config, const std::vector<std::string>& queries,
+                     const int32_t refLen)
+{
+    if (config.Fallback) {
+        return std::min(MIN_ALIGN_BANDWIDTH, EstimateAlignBandwidth(queries, refLen));
+    }
+    return config.AutoBandwidth ? EstimateAlignBandwidth(queries, refLen) : DEFAULT_ALIGN_BANDWIDTH;
+}
+
+bool IsTruncated(const AlnResults& alns, const int64_t refLen)
+{
+    if (alns.empty()) {
+        return true;
+    }
+    for (const auto& a : alns) {
+        if (!a->isAligned || a->isSecondary || a->isSupplementary) {
+            continue;
+        }
+        // Query coordinates in reference orientation
+        const int64_t qStart = a->rReversed ? a->qLen - a->qEnd : a->qStart;
+        const int64_t qEnd = a->rReversed ? a->qLen - a->qStart : a->qEnd;
+        const bool openFront = qStart > TRUNCATION_SLACK && a->rStart > TRUNCATION_SLACK;
+        const bool openBack =
+            (a->qLen - qEnd) > TRUNCATION_SLACK && (refLen - a->rEnd) > TRUNCATION_SLACK;
+        if (openFront || openBack) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HasPrimary(const AlnResults& alns)
+{
+    return std::any_of(alns.cbegin(), alns.cend(), [](const auto& a) {
+        return a->isAligned && !a->isSecondary && !a->isSupplementary;
+    });
+}
+
+// Returns the strand of a primary alignment that is long and accurate enough
+// to anchor the pass alternation, true for reverse.
+std::optional<bool> ConfidentStrand(const AlnResults& alns)
+{
+    for (const auto& a : alns) {
+        if (!a->isAligned || a->isSecondary || a->isSupplementary) {
+            continue;
+        }
+        const int64_t span = a->qEnd - a->qStart;
+        if (span >= MIN_STRAND_ANCHOR_SPAN && span >= MIN_STRAND_ANCHOR_FRACTION * a->qLen &&
+            CalcAlignmentIdentity(a->cigar) >= MIN_STRAND_ANCHOR_IDENTITY) {
+            return a->rReversed;
+        }
+    }
+    return std::nullopt;
+}
+
+// Convert a result of the reverse-complemented query into one of the query
+void FlipQueryStrand(AlignmentResult& a)
+{
+    // The CIGAR is stored in reference orientation and stays as is
+    a.rReversed = !a.rReversed;
+    const int64_t qStart = a.qLen - a.qEnd;
+    a.qEnd = a.qLen - a.qStart;
+    a.qStart = qStart;
+}
+
+}  // namespace
+
+std::vector<AlnResults> PancakeAligner(Pancake::MapperCLR& mapper,
+                                       const Pancake::MapperCLRMapSettings& mapSettings,
+                                       const std::vector<std::string>& queries,
+                                       const std::string& reference)
+{
+    if (queries.empty()) {
+        return {};
+    }
+
+    if (reference.empty()) {
+        return {};
+    }
+
+    // Prepare the target for mapping.
+    std::vector<std::string> refs = {reference};
+
+    std::vector<AlnResults> ret(queries.size());
+    if (!zmwDeadline) {
+        auto mappingResults = mapper.MapAndAlign(refs, queries);
+        ConvertMappings(mappingResults, 0, ret);
+        return ret;
+    }
+
+    // Under a deadline, queries are mapped one at a time so that no further
+    // query starts once it passed. The reference is seeded once per ZMW.
+    const ReferenceIndex& index = ZmwReferenceIndex(reference, mapSettings);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        if (std::chrono::steady_clock::now() > *zmwDeadline) {
+            zmwDeadlineExceeded = true;
+            break;
+        }
+        std::vector<Pancake::MapperBaseResult> mappingResults;
+        mappingResults.emplace_back(index.MapAndAlign(mapper, mapSettings, queries[i], i));
+        ConvertMappings(mappingResults, i, ret);
+    }
 
     return ret;
 }
 
-Pancake::MapperCLRMapSettings InitPancakeMapSettingsSubread(const bool shortInsert)
+bool IsLowComplexity(const std::string& sequence)
+{
+    constexpr uint64_t mask = (uint64_t{1} << (2 * COMPLEXITY_KMER_SIZE)) - 1;
+    std::vector<uint64_t> kmers;
+    kmers.reserve(sequence.size());
+    uint64_t kmer = 0;
+    int32_t validBases = 0;
+    for (const char base : sequence) {
+        uint64_t code;
+        switch (base) {
+            case 'A':
+                code = 0;
+                break;
+            case 'C':
+                code = 1;
+                break;
+            case 'G':
+                code = 2;
+                break;
+            case 'T':
+                code = 3;
+                break;
+            default:
+                validBases = 0;
+                continue;
+        }
+        kmer = ((kmer << 2) | code) & mask;
+        if (++validBases >= COMPLEXITY_KMER_SIZE) {
+            kmers.emplace_back(kmer);
+        }
+    }
+    if (kmers.empty()) {
+        return false;
+    }
+    const std::size_t numKmers = kmers.size();
+    std::sort(kmers.begin(), kmers.end());
+    const std::size_t numDistinct = std::unique(kmers.begin(), kmers.end()) - kmers.begin();
+    return numDistinct < MIN_DISTINCT_KMER_FRACTION * numKmers;
+}
+
+Pancake::MapperCLRMapSettings InitPancakeMapSettingsSubread(const bool shortInsert,
+                                                            const bool primaryOnly,
+                                                            const bool lowComplexity)
 {
     Pancake::MapperCLRMapSettings settings;
 
@@ -90,18 +418,35 @@ Pancake::MapperCLRMapSettings InitPancakeMapSettingsSubread(const bool shortInse
         settings.minDPScore = 10;
         settings.minNumSeeds = 2;
         settings.minQueryLen = 0;
+    } else if (lowComplexity) {
+        // Every seed of a repeat hits each copy, sparser minimizers and a
+        // tighter occurrence cutoff keep the number of seed hits bounded
+        settings.seedParams.MinimizerWindow = 10;
+        settings.seedParamsFallback.MinimizerWindow = 10;
+        settings.seedOccurrenceMaxMemory = 10'000'000;
+        settings.seedOccurrenceMax = 200;
+    }
+
+    if (primaryOnly) {
+        // Every chain besides the primary one is labelled secondary and dropped
+        // before alignment, which also rules out supplementary alignments
+        settings.secondaryAllowedOverlapFractionQuery = -1.0;
+        settings.secondaryAllowedOverlapFractionTarget = -1.0;
+        settings.bestNSecondary = 0;
     }
 
     return settings;
 }
 
-Pancake::MapperCLRAlignSettings InitPancakeAlignSettingsSubread()
+Pancake::MapperCLRAlignSettings InitPancakeAlignSettingsSubread(const int32_t alignBandwidth)
 {
     Pancake::MapperCLRAlignSettings settings;
 
-    settings.alnParamsGlobal.zdrop = 400;
-    settings.alnParamsGlobal.zdrop2 = 200;
-    settings.alnParamsGlobal.alignBandwidth = 500;
+    // The default band of 500 uses z-drop 400, narrower bands stop earlier
+    const int32_t zdrop = std::clamp(alignBandwidth * 4 / 5, 100, 400);
+    settings.alnParamsGlobal.zdrop = zdrop;
+    settings.alnParamsGlobal.zdrop2 = zdrop / 2;
+    settings.alnParamsGlobal.alignBandwidth = alignBandwidth;
     settings.alnParamsGlobal.endBonus = 0;
     settings.alnParamsGlobal.matchScore = 2;
     settings.alnParamsGlobal.mismatchPenalty = 4;
@@ -116,21 +461,320 @@ Pancake::MapperCLRAlignSettings InitPancakeAlignSettingsSubread()
     return settings;
 }
 
-Pancake::MapperCLRSettings InitPancakeSettingsSubread(const bool shortInsert)
+Pancake::MapperCLRSettings InitPancakeSettingsSubread(const bool shortInsert,
+                                                      const int32_t alignBandwidth,
+                                                      const bool primaryOnly,
+                                                      const bool lowComplexity)
 {
     Pancake::MapperCLRSettings settings;
-    settings.map = InitPancakeMapSettingsSubread(shortInsert);
-    settings.align = InitPancakeAlignSettingsSubread();
+    settings.map = InitPancakeMapSettingsSubread(shortInsert, primaryOnly, lowComplexity);
+    settings.align = InitPancakeAlignSettingsSubread(alignBandwidth);
 
     return settings;
 }
 
-std::vector<AlnResults> PancakeAlignerSubread(const std::vector<BAM::BamRecord>& reads,
-                                              const std::string& reference)
+int32_t EstimateAlignBandwidth(const std::vector<std::string>& queries, const int32_t refLen)
+{
+    // The largest length difference between a full pass and the CCS bounds
+    // the net indel drift, allow for local excursions on top of it.
+    int32_t maxLenDiff = -1;
+    for (const auto& q : queries) {
+        const int32_t lenDiff = std::abs(static_cast<int32_t>(q.size()) - refLen);
+        if (lenDiff <= FULL_PASS_LENGTH_TOLERANCE * refLen) {
+            maxLenDiff = std::max(maxLenDiff, lenDiff);
+        }
+    }
+    if (maxLenDiff < 0) {
+        return DEFAULT_ALIGN_BANDWIDTH;
+    }
+    const int32_t bandwidth = 2 * maxLenDiff + refLen / 100 + MIN_ALIGN_BANDWIDTH / 2;
+    return std::clamp(bandwidth, MIN_ALIGN_BANDWIDTH, DEFAULT_ALIGN_BANDWIDTH);
+}
+
+namespace {
+
+struct StrandAnchor
+{
+    int32_t Idx{-1};
+    bool Reversed{false};
+};
+
+// Map queries one by one in both orientations until one maps confidently.
+// Results of all tried queries are stored in alns.
+StrandAnchor FindStrandAnchor(Pancake::MapperCLR& mapper, const MapperSetup& setup,
+                              const std::vector<std::string>& queries, const std::string& reference,
+                              std::vector<AlnResults>& alns, int32_t& numTried)
+{
+    const int32_t maxTries =
+        std::min(static_cast<int32_t>(queries.size()), MAX_STRAND_ANCHOR_TRIES);
+    for (numTried = 0; numTried < maxTries;) {
+        const int32_t i = numTried++;
+        std::vector<AlnResults> anchorAlns = PancakeAligner(
+            mapper, setup.Settings.map, std::vector<std::string>{queries[i]}, reference);
+        alns[i] = std::move(anchorAlns[0]);
+        const std::optional<bool> reversed = ConfidentStrand(alns[i]);
+        if (reversed) {
+            PBLOG_DEBUG << "Strand anchor is subread " << i;
+            return {i, *reversed};
+        }
+    }
+    PBLOG_DEBUG << "No strand anchor among the first " << numTried << " subreads";
+    return {};
+}
+
+// Consecutive passes alternate strand
+bool IsReversedPass(const StrandAnchor& anchor, const int32_t idx)
+{
+    return anchor.Reversed != ((idx - anchor.Idx) % 2 != 0);
+}
+
+// Orient every query onto the forward strand of the reference and only seed
+// that orientation. Queries without a primary alignment are remapped in both
+// orientations.
+std::vector<AlnResults> AlignOriented(const MapperSetup& setup,
+                                      const std::vector<std::string>& queries,
+                                      const std::vector<bool>& reversed,
+                                      const std::string& reference)
 {
-    Pancake::MapperCLRSettings settings =
-        InitPancakeSettingsSubread(static_cast<int32_t>(reference.size()) < 200);
-    Pancake::MapperCLR mapper(settings);
-    return PancakeAligner(mapper, reads, reference);
+    std::vector<std::string> oriented;
+    oriented.reserve(queries.size());
+    for (int32_t i = 0; i < std::ssize(queries); ++i) {
+        oriented.emplace_back(reversed[i] ? Utility::ReverseComplemented(queries[i]) : queries[i]);
+    }
+    MapperVariant forwardVariant = setup.Variant;
+    forwardVariant.ForwardOnly = true;
+    const MapperSetup forward = MakeMapperSetup(forwardVariant);
+    const auto forwardMapper = CachedMapper(forward);
+    std::vector<AlnResults> alns =
+        PancakeAligner(*forwardMapper, forward.Settings.map, oriented, reference);
+
+    std::vector<int32_t> retryIdx;
+    std::vector<std::string> retryQueries;
+    for (int32_t i = 0; i < std::ssize(alns); ++i) {
+        if (!HasPrimary(alns[i])) {
+            retryIdx.emplace_back(i);
+            retryQueries.emplace_back(queries[i]);
+            alns[i].clear();
+        } else if (reversed[i]) {
+            for (auto& a : alns[i]) {
+                FlipQueryStrand(*a);
+            }
+        }
+    }
+    if (!retryIdx.empty()) {
+        PBLOG_DEBUG << "Strand prediction failed for " << retryIdx.size() << " of "
+                    << queries.size() << " subreads, mapping both orientations";
+        const auto mapper = CachedMapper(setup);
+        std::vector<AlnResults> retryAlns =
+            PancakeAligner(*mapper, setup.Settings.map, retryQueries, reference);
+        for (int32_t i = 0; i < std::ssize(retryIdx); ++i) {
+            alns[retryIdx[i]] = std::move(retryAlns[i]);
+        }
+    }
+    return alns;
+}
+
+// Realign with the default band the queries whose alignment ran into a
+// narrower one
+void WidenTruncated(const MapperSetup& setup, const std::vector<std::string>& queries,
+                    const std::string& reference, std::vector<AlnResults>& alns)
+{
+    const int64_t refLen = reference.size();
+    std::vector<int32_t> retryIdx;
+    std::vector<std::string> retryQueries;
+    for (int32_t i = 0; i < std::ssize(alns); ++i) {
+        if (IsTruncated(alns[i], refLen)) {
+            retryIdx.emplace_back(i);
+            retryQueries.emplace_back(queries[i]);
+        }
+    }
+    if (retryIdx.empty()) {
+        return;
+    }
+    PBLOG_DEBUG << "Realigning " << retryIdx.size()
+                << " truncated alignments with the default band";
+
+    MapperVariant wideVariant = setup.Variant;
+    wideVariant.AlignBandwidth = DEFAULT_ALIGN_BANDWIDTH;
+    const MapperSetup wide = MakeMapperSetup(wideVariant);
+    const auto wideMapper = CachedMapper(wide);
+    std::vector<AlnResults> wideAlns =
+        PancakeAligner(*wideMapper, wide.Settings.map, retryQueries, reference);
+    for (int32_t i = 0; i < std::ssize(retryIdx); ++i) {
+        if (!wideAlns[i].empty()) {
+            alns[retryIdx[i]] = std::move(wideAlns[i]);
+        }
+    }
+}
+
+// Align a subset of queries, given by index, to one reference
+void AlignSubset(const MapperSetup& setup, const bool predictStrand, const bool widen,
+                 const std::vector<std::string>& queries, const std::vector<int32_t>& subset,
+                 const std::string& reference, const int32_t refId, std::vector<AlnResults>& alns)
+{
+    if (subset.empty()) {
+        return;
+    }
+    std::vector<std::string> subsetQueries;
+    subsetQueries.reserve(subset.size());
+    for (const int32_t idx : subset) {
+        subsetQueries.emplace_back(queries[idx]);
+    }
+    std::vector<AlnResults> subsetAlns;
+    if (predictStrand) {
+        subsetAlns = AlignOriented(setup, subsetQueries,
+                                   std::vector<bool>(subsetQueries.size(), false), reference);
+    } else {
+        const auto mapper = CachedMapper(setup);
+        subsetAlns = PancakeAligner(*mapper, setup.Settings.map, subsetQueries, reference);
+    }
+    if (widen) {
+        WidenTruncated(setup, subsetQueries, reference, subsetAlns);
+    }
+    for (int32_t i = 0; i < std::ssize(subset); ++i) {
+        for (auto& a : subsetAlns[i]) {
+            a->rId = refId;
+        }
+        alns[subset[i]] = std::move(subsetAlns[i]);
+    }
+}
+
+// Align all queries in the orientation predicted from a strand anchor
+std::vector<AlnResults> PancakeAlignerPredictedStrand(const MapperSetup& setup,
+                                                      const std::vector<std::string>& queries,
+                                                      const std::string& reference)
+{
+    if (queries.empty() || reference.empty()) {
+        return {};
+    }
+
+    const int32_t numQueries = queries.size();
+    std::vector<AlnResults> alns(numQueries);
+
+    const auto mapper = CachedMapper(setup);
+    int32_t numTried = 0;
+    const StrandAnchor anchor =
+        FindStrandAnchor(*mapper, setup, queries, reference, alns, numTried);
+    if (numTried == numQueries) {
+        return alns;
+    }
+
+    std::vector<std::string> rest{queries.begin() + numTried, queries.end()};
+    std::vector<AlnResults> restAlns;
+    if (anchor.Idx == -1) {
+        restAlns = PancakeAligner(*mapper, setup.Settings.map, rest, reference);
+    } else {
+        std::vector<bool> reversed;
+        for (int32_t i = numTried; i < numQueries; ++i) {
+            reversed.emplace_back(IsReversedPass(anchor, i));
+        }
+        restAlns = AlignOriented(setup, rest, reversed, reference);
+    }
+    std::move(restAlns.begin(), restAlns.end(), alns.begin() + numTried);
+    return alns;
+}
+
+}  // namespace
+
+AlignmentDeadline::AlignmentDeadline(const double seconds)
+{
+    zmwDeadline = std::chrono::steady_clock::now() +
+                  std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double>(seconds));
+    zmwDeadlineExceeded = false;
+    zmwReferenceIndices.clear();
+}
+
+AlignmentDeadline::~AlignmentDeadline()
+{
+    zmwDeadline.reset();
+    zmwDeadlineExceeded = false;
+    zmwReferenceIndices.clear();
+}
+
+bool AlignmentDeadline::Exceeded() const { return zmwDeadlineExceeded; }
+
+std::vector<AlnResults> PancakeAlignerSubread(const std::vector<std::string>& queries,
+                                              const std::string& reference,
+                                              const SubreadAlignerConfig& config)
+{
+    const int32_t refLen = reference.size();
+    const bool shortInsert = refLen < 200;
+    const bool lowComplexity = !shortInsert && IsLowComplexity(reference);
+    if (lowComplexity) {
+        PBLOG_DEBUG << "Low-complexity CCS, seeding with sparse minimizers";
+    }
+
+    const int32_t bandwidth = ZmwBandwidth(config, queries, refLen);
+    const MapperSetup setup = MakeMapperSetup(
+        {shortInsert, bandwidth, config.PrimaryOnly || config.Fallback, lowComplexity});
+    LogAlignmentBand(setup);
+    std::vector<AlnResults> alns;
+    if (config.PredictStrand) {
+        alns = PancakeAlignerPredictedStrand(setup, queries, reference);
+    } else {
+        const auto mapper = CachedMapper(setup);
+        alns = PancakeAligner(*mapper, setup.Settings.map, queries, reference);
+    }
+    if (bandwidth < DEFAULT_ALIGN_BANDWIDTH && !config.Fallback) {
+        WidenTruncated(setup, queries, reference, alns);
+    }
+    return alns;
+}
+
+std::vector<AlnResults> PancakeAlignerByStrand(const std::vector<std::string>& queries,
+                                               const std::string& fwdReference,
+                                               const std::string& revReference,
+                                               const SubreadAlignerConfig& config)
+{
+    if (queries.empty() || fwdReference.empty() || revReference.empty()) {
+        return {};
+    }
+
+    const int32_t refLen = fwdReference.size();
+    const bool shortInsert = refLen < 200;
+    // Both strands share their k-mer spectrum
+    const bool lowComplexity = !shortInsert && IsLowComplexity(fwdReference);
+    if (lowComplexity) {
+        PBLOG_DEBUG << "Low-complexity CCS, seeding with sparse minimizers";
+    }
+    const int32_t numQueries = queries.size();
+
+    const int32_t bandwidth = ZmwBandwidth(config, queries, refLen);
+    const bool widen = bandwidth < DEFAULT_ALIGN_BANDWIDTH && !config.Fallback;
+    const MapperSetup setup = MakeMapperSetup(
+        {shortInsert, bandwidth, config.PrimaryOnly || config.Fallback, lowComplexity});
+    LogAlignmentBand(setup);
+
+    // The anchor decides which passes belong to the forward strand
+    std::vector<AlnResults> alns(numQueries);
+    const auto mapper = CachedMapper(setup);
+    int32_t numTried = 0;
+    const StrandAnchor anchor =
+        FindStrandAnchor(*mapper, setup, queries, fwdReference, alns, numTried);
+    if (anchor.Idx == -1) {
+        PBLOG_DEBUG << "Could not assign subreads to strands, aligning all to forward CCS";
+        std::vector<int32_t> rest;
+        for (int32_t i = numTried; i < numQueries; ++i) {
+            rest.emplace_back(i);
+        }
+        AlignSubset(setup, false, widen, queries, rest, fwdReference, 0, alns);
+        return alns;
+    }
+
+    // Forward CCS alignments of tried forward passes are kept
+    std::vector<int32_t> fwdSubset;
+    std::vector<int32_t> revSubset;
+    for (int32_t i = 0; i < numQueries; ++i) {
+        if (IsReversedPass(anchor, i)) {
+            alns[i].clear();
+            revSubset.emplace_back(i);
+        } else if (i >= numTried) {
+            fwdSubset.emplace_back(i);
+        }
+    }
+    AlignSubset(setup, config.PredictStrand, widen, queries, fwdSubset, fwdReference, 0, alns);
+    AlignSubset(setup, config.PredictStrand, widen, queries, revSubset, revReference, 1, alns);
+    return alns;
 }
 }  // namespace PacBio
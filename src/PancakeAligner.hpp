@@ -1,8 +1,8 @@
 #pragma once
 
 #include "AlignmentResult.hpp"
+#include "SubreadAlignerConfig.hpp"
 
-#include <pbbam/BamRecord.h>
 #include <pancake/MapperCLR.hpp>
 
 #include <cstdint>
@@ -11,16 +11,58 @@
 
 namespace PacBio {
 
+// Bandwidth used when no better estimate is available, also used to realign
+// alignments that were truncated by a narrower band.
+constexpr int32_t DEFAULT_ALIGN_BANDWIDTH = 500;
+constexpr int32_t MIN_ALIGN_BANDWIDTH = 100;
+
+// Time budget for the alignment on the calling thread. While it is active,
+// queries are mapped one at a time against a seed index built once per
+// reference, and none starts after the deadline, those get no alignment.
+class AlignmentDeadline
+{
+public:
+    explicit AlignmentDeadline(double seconds);
+    AlignmentDeadline(const AlignmentDeadline&) = delete;
+    AlignmentDeadline& operator=(const AlignmentDeadline&) = delete;
+    ~AlignmentDeadline();
+
+    // True if queries were skipped
+    bool Exceeded() const;
+};
+
+// The map settings must be those the mapper was created with
 std::vector<AlnResults> PancakeAligner(Pancake::MapperCLR& mapper,
-                                       const std::vector<BAM::BamRecord>& reads,
+                                       const Pancake::MapperCLRMapSettings& mapSettings,
+                                       const std::vector<std::string>& queries,
                                        const std::string& reference);
 
-Pancake::MapperCLRMapSettings InitPancakeMapSettingsSubread(const bool shortInsert);
+// Repeats and low-complexity inserts, the profile costs one sort of the
+// CCS k-mers
+bool IsLowComplexity(const std::string& sequence);
+
+Pancake::MapperCLRMapSettings InitPancakeMapSettingsSubread(const bool shortInsert,
+                                                            const bool primaryOnly = false,
+                                                            const bool lowComplexity = false);
+
+Pancake::MapperCLRAlignSettings InitPancakeAlignSettingsSubread(
+    const int32_t alignBandwidth = DEFAULT_ALIGN_BANDWIDTH);
+
+Pancake::MapperCLRSettings InitPancakeSettingsSubread(
+    const bool shortInsert, const int32_t alignBandwidth = DEFAULT_ALIGN_BANDWIDTH,
+    const bool primaryOnly = false, const bool lowComplexity = false);
 
-Pancake::MapperCLRAlignSettings InitPancakeAlignSettingsSubread();
+int32_t EstimateAlignBandwidth(const std::vector<std::string>& queries, const int32_t refLen);
 
-Pancake::MapperCLRSettings InitPancakeSettingsSubread(const bool shortInsert);
+// Queries are the decoded subread sequences
+std::vector<AlnResults> PancakeAlignerSubread(const std::vector<std::string>& queries,
+                                              const std::string& reference,
+                                              const SubreadAlignerConfig& config);
 
-std::vector<AlnResults> PancakeAlignerSubread(const std::vector<BAM::BamRecord>& reads,
-                                              const std::string& reference);
+// Align the passes of a by-strand ZMW to the CCS of their own strand. The
+// rId of each result is 0 for the forward and 1 for the reverse CCS.
+std::vector<AlnResults> PancakeAlignerByStrand(const std::vector<std::string>& queries,
+                                               const std::string& fwdReference,
+                                               const std::string& revReference,
+                                               const SubreadAlignerConfig& config);
 }  // namespace PacBio
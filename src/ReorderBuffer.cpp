@@ -0,0 +1,109 @@
+#include "ReorderBuffer.hpp"
+
+#include <pbbam/BamFile.h>
+#include <pbbam/BamWriter.h>
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+
+#include <filesystem>
+#include <system_error>
+#include <utility>
+
+namespace PacBio {
+
+ReorderBuffer::ReorderBuffer(std::string spillPrefix, BAM::BamHeader header,
+                             const std::size_t maxRecords, const IO::BgzfThreadPool* pool)
+    : spillPrefix_{std::move(spillPrefix)}
+    , header_{std::move(header)}
+    , maxRecords_{maxRecords}
+    , pool_{pool}
+{
+}
+
+ReorderBuffer::~ReorderBuffer()
+{
+    for (SpillFile& file : spillFiles_) {
+        if (file.NumWaiting > 0) {
+            file.Reader.reset();
+            std::error_code error;
+            std::filesystem::remove(file.Filename, error);
+        }
+    }
+}
+
+void ReorderBuffer::Add(const int32_t rank, ZmwOutput zmw)
+{
+    if (rank < nextRank_ || waiting_.find(rank) != waiting_.cend()) {
+        throw PB_CLI_ALARM("ZMW rank " + std::to_string(rank) + " added twice");
+    }
+    numBufferedRecords_ += zmw.Records.size();
+    waiting_.emplace(rank, Waiting{std::move(zmw)});
+    // The next rank leaves right away, spilling it would be wasted
+    if (numBufferedRecords_ > maxRecords_ && rank != nextRank_) {
+        Spill();
+    }
+}
+
+bool ReorderBuffer::Next(ZmwOutput& zmw)
+{
+    if (waiting_.empty() || waiting_.cbegin()->first != nextRank_) {
+        return false;
+    }
+    auto node = waiting_.extract(waiting_.begin());
+    Waiting& waiting = node.mapped();
+    if (waiting.SpillIdx == -1) {
+        numBufferedRecords_ -= waiting.Zmw.Records.size();
+    } else {
+        // Ranks within a spill file ascend, it is read front to back
+        SpillFile& file = spillFiles_[waiting.SpillIdx];
+        if (!file.Reader) {
+            file.Reader = std::make_unique<IO::PooledBamReader>(BAM::BamFile{file.Filename}, pool_);
+        }
+        waiting.Zmw.Records.resize(waiting.NumSpilledRecords);
+        for (BAM::BamRecord& record : waiting.Zmw.Records) {
+            if (!file.Reader->GetNext(record)) {
+                throw PB_CLI_ALARM("Spill file " + file.Filename + " is truncated");
+            }
+        }
+        if (--file.NumWaiting == 0) {
+            file.Reader.reset();
+            std::filesystem::remove(file.Filename);
+        }
+    }
+    zmw = std::move(waiting.Zmw);
+    ++nextRank_;
+    return true;
+}
+
+std::size_t ReorderBuffer::NumWaiting() const { return waiting_.size(); }
+
+int64_t ReorderBuffer::NumSpilled() const { return numSpilled_; }
+
+void ReorderBuffer::Spill()
+{
+    const int32_t spillIdx = spillFiles_.size();
+    SpillFile file{spillPrefix_ + '.' + std::to_string(spillIdx), nullptr, 0};
+    {
+        // Read back once, speed matters more than size
+        BAM::BamWriter writer{file.Filename, header_, BAM::BamWriter::CompressionLevel_1, 1};
+        for (auto& [rank, waiting] : waiting_) {
+            if (waiting.SpillIdx != -1 || waiting.Zmw.Records.empty()) {
+                continue;
+            }
+            for (const BAM::BamRecord& record : waiting.Zmw.Records) {
+                writer.Write(record);
+            }
+            waiting.SpillIdx = spillIdx;
+            waiting.NumSpilledRecords = waiting.Zmw.Records.size();
+            std::vector<BAM::BamRecord>{}.swap(waiting.Zmw.Records);
+            ++file.NumWaiting;
+            ++numSpilled_;
+        }
+    }
+    PBLOG_BLOCK_DEBUG("Reorder", "Spilled " + std::to_string(numBufferedRecords_) + " records to " +
+                                     file.Filename);
+    numBufferedRecords_ = 0;
+    spillFiles_.emplace_back(std::move(file));
+}
+
+}  // namespace PacBio
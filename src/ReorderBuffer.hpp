@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ZmwAligner.hpp"
+#include "io/BgzfThreadPool.hpp"
+
+#include <pbbam/BamHeader.h>
+#include <pbbam/BamRecord.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace PacBio {
+
+// Restores the order of ZMWs aligned out of order. ZMWs are added with their
+// rank, 0, 1, ..., and taken out in rank order once all earlier ranks arrived.
+// Beyond maxRecords records held in memory, the records of all waiting ZMWs
+// are spilled to a new BAM file PREFIX.N and read back sequentially when their
+// turn comes. Spill files are removed once drained.
+class ReorderBuffer
+{
+public:
+    ReorderBuffer(std::string spillPrefix, BAM::BamHeader header, std::size_t maxRecords,
+                  const IO::BgzfThreadPool* pool);
+    ReorderBuffer(const ReorderBuffer&) = delete;
+    ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+    ~ReorderBuffer();
+
+    void Add(int32_t rank, ZmwOutput zmw);
+
+    // Returns false if the next rank has not arrived yet
+    bool Next(ZmwOutput& zmw);
+
+    // ZMWs added but not taken out
+    std::size_t NumWaiting() const;
+
+    // ZMWs whose records went through a spill file
+    int64_t NumSpilled() const;
+
+private:
+    struct Waiting
+    {
+        ZmwOutput Zmw;
+        // Spill file holding the records, -1 if they are in memory
+        int32_t SpillIdx{-1};
+        int32_t NumSpilledRecords{0};
+    };
+
+    struct SpillFile
+    {
+        std::string Filename;
+        std::unique_ptr<IO::PooledBamReader> Reader;
+        int32_t NumWaiting{0};
+    };
+
+    void Spill();
+
+    const std::string spillPrefix_;
+    const BAM::BamHeader header_;
+    const std::size_t maxRecords_;
+    const IO::BgzfThreadPool* const pool_;
+    std::map<int32_t, Waiting> waiting_;
+    std::vector<SpillFile> spillFiles_;
+    int32_t nextRank_{0};
+    std::size_t numBufferedRecords_{0};
+    int64_t numSpilled_{0};
+};
+
+}  // namespace PacBio
@@ -0,0 +1,202 @@
+#include "Server.hpp"
+
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+#include <pbcopper/utility/Stopwatch.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace PacBio {
+namespace {
+
+constexpr int LISTEN_BACKLOG = 64;
+
+sockaddr_un SocketAddress(const std::string& socketPath)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw PB_CLI_ALARM("Socket path too long: " + socketPath);
+    }
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    return address;
+}
+
+// True if another server accepts connections on the socket
+bool IsServing(const sockaddr_un& address)
+{
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+    const bool serving =
+        ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    ::close(fd);
+    return serving;
+}
+
+void Reply(const int connection, const std::string& message)
+{
+    const std::string line = message + '\n';
+    std::size_t sent = 0;
+    while (sent < line.size()) {
+        const ssize_t n = ::send(connection, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            PBLOG_BLOCK_WARN("Server", "Client went away before the reply");
+            return;
+        }
+        sent += n;
+    }
+}
+
+}  // namespace
+
+ServerJob ParseServerJob(const std::string& line)
+{
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of("\t"));
+    if (fields.size() < 3) {
+        throw PB_CLI_ALARM("Job needs IN.subreads.bam, IN.ccs.bam and OUT.bam separated by tabs");
+    }
+
+    ServerJob job;
+    job.SubreadFile = fields[0];
+    job.CcsFile = fields[1];
+    job.OutputFile = fields[2];
+    for (std::size_t i = 3; i < fields.size(); ++i) {
+        const std::string& field = fields[i];
+        if (boost::starts_with(field, "chunk=")) {
+            job.Chunk = field.substr(6);
+        } else if (boost::starts_with(field, "zmws=")) {
+            std::tie(job.MinZmw, job.MaxZmw) = ParseZmwRange(field.substr(5));
+        } else {
+            throw PB_CLI_ALARM("Unknown job field: " + field);
+        }
+    }
+    return job;
+}
+
+std::pair<int32_t, int32_t> ParseZmwRange(const std::string& range)
+{
+    std::vector<std::string> bounds;
+    boost::split(bounds, range, boost::is_any_of("-"));
+    std::pair<int32_t, int32_t> result;
+    try {
+        if (bounds.size() != 2) {
+            throw boost::bad_lexical_cast{};
+        }
+        result = {boost::lexical_cast<int32_t>(bounds[0]), boost::lexical_cast<int32_t>(bounds[1])};
+    } catch (const boost::bad_lexical_cast&) {
+        throw PB_CLI_ALARM("Wrong format for ZMW range, expected FIRST-LAST: " + range);
+    }
+    if (result.first < 0 || result.first > result.second) {
+        throw PB_CLI_ALARM("Empty ZMW range: " + range);
+    }
+    return result;
+}
+
+JobServer::JobServer(std::string socketPath) : socketPath_{std::move(socketPath)}
+{
+    const sockaddr_un address = SocketAddress(socketPath_);
+    if (::access(socketPath_.c_str(), F_OK) == 0) {
+        if (IsServing(address)) {
+            throw PB_CLI_ALARM("Another server is listening on " + socketPath_);
+        }
+        ::unlink(socketPath_.c_str());
+    }
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        throw PB_CLI_ALARM("Could not create socket: " + std::string{std::strerror(errno)});
+    }
+    if (::bind(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd_, LISTEN_BACKLOG) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(fd_);
+        throw PB_CLI_ALARM("Could not listen on " + socketPath_ + ": " + error);
+    }
+    PBLOG_BLOCK_INFO("Server", "Listening on " + socketPath_);
+}
+
+JobServer::~JobServer()
+{
+    ::close(fd_);
+    ::unlink(socketPath_.c_str());
+}
+
+void JobServer::Serve(const Handler& handler)
+{
+    while (true) {
+        const int connection = ::accept(fd_, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw PB_CLI_ALARM("Could not accept connection: " + std::string{std::strerror(errno)});
+        }
+        const bool keepServing = HandleConnection(connection, handler);
+        ::close(connection);
+        if (!keepServing) {
+            PBLOG_BLOCK_INFO("Server", "Shutting down");
+            return;
+        }
+    }
+}
+
+bool JobServer::HandleConnection(const int connection, const Handler& handler)
+{
+    std::string buffer;
+    char chunk[4096];
+    while (true) {
+        const ssize_t n = ::recv(connection, chunk, sizeof(chunk), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return true;
+        }
+        buffer.append(chunk, n);
+
+        std::size_t end;
+        while ((end = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, end);
+            buffer.erase(0, end + 1);
+            boost::trim_right_if(line, boost::is_any_of("\r"));
+            if (line.empty()) {
+                continue;
+            }
+            if (line == "shutdown") {
+                Reply(connection, "OK");
+                return false;
+            }
+
+            Utility::Stopwatch timer;
+            try {
+                handler(ParseServerJob(line));
+                timer.Freeze();
+                PBLOG_BLOCK_INFO("Server", "Job done in " + timer.ElapsedTime());
+                Reply(connection, "OK");
+            } catch (const std::exception& e) {
+                PBLOG_BLOCK_ERROR("Server", std::string{"Job failed: "} + e.what());
+                Reply(connection, std::string{"ERROR "} + e.what());
+            }
+        }
+    }
+}
+
+}  // namespace PacBio
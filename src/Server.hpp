@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace PacBio {
+
+// One alignment job, sent as one line of tab-separated fields:
+//   IN.subreads.bam  IN.ccs.bam  OUT.bam  [chunk=i/N]  [zmws=FIRST-LAST]
+struct ServerJob
+{
+    std::string SubreadFile;
+    std::string CcsFile;
+    std::string OutputFile;
+    std::string Chunk;
+    // Inclusive hole number range, -1 if unbounded
+    int32_t MinZmw{-1};
+    int32_t MaxZmw{-1};
+};
+
+ServerJob ParseServerJob(const std::string& line);
+
+// Parses an inclusive hole number range FIRST-LAST, as in zmws= and --zmws
+std::pair<int32_t, int32_t> ParseZmwRange(const std::string& range);
+
+// Accepts jobs on a Unix domain socket and runs them one at a time, each with
+// the full thread budget. A connection may send several jobs, each is answered
+// with a line "OK" or "ERROR <message>". The line "shutdown" stops the server.
+class JobServer
+{
+public:
+    using Handler = std::function<void(const ServerJob&)>;
+
+    // A stale socket of an earlier server is replaced
+    explicit JobServer(std::string socketPath);
+    JobServer(const JobServer&) = delete;
+    JobServer& operator=(const JobServer&) = delete;
+    ~JobServer();
+
+    // Returns after a shutdown request
+    void Serve(const Handler& handler);
+
+private:
+    // Returns false on shutdown
+    bool HandleConnection(int connection, const Handler& handler);
+
+    std::string socketPath_;
+    int fd_{-1};
+};
+
+}  // namespace PacBio
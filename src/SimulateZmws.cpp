@@ -0,0 +1,304 @@
+// Writes synthetic subread and CCS BAM files with PBIs for benchmarks. Each
+// ZMW is a random insert, its CCS is the insert itself and its subreads are
+// full passes of alternating strands with random errors.
+
+#include "LibraryInfo.hpp"
+
+#include <pbbam/BamFile.h>
+#include <pbbam/BamHeader.h>
+#include <pbbam/BamRecord.h>
+#include <pbbam/BamRecordImpl.h>
+#include <pbbam/BamWriter.h>
+#include <pbbam/ReadGroupInfo.h>
+#include <pbbam/TagCollection.h>
+#include <pbcopper/cli2/CLI.h>
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+#include <pbcopper/utility/SequenceUtils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace PacBio {
+namespace OptionNames {
+// clang-format off
+const CLI_v2::Option NumZmws{
+R"({
+    "names" : ["zmws"],
+    "description" : "Number of ZMWs.",
+    "type" : "int",
+    "default" : 1000
+})"
+};
+const CLI_v2::Option InsertMean{
+R"({
+    "names" : ["insert-mean"],
+    "description" : "Mean insert length, lengths are log-normal distributed.",
+    "type" : "int",
+    "default" : 10000
+})"
+};
+const CLI_v2::Option InsertSd{
+R"({
+    "names" : ["insert-sd"],
+    "description" : "Standard deviation of the insert length, 0 for inserts of the mean length.",
+    "type" : "int",
+    "default" : 2000
+})"
+};
+const CLI_v2::Option Passes{
+R"({
+    "names" : ["passes"],
+    "description" : "Mean number of full passes, Poisson distributed with at least one.",
+    "type" : "int",
+    "default" : 8
+})"
+};
+const CLI_v2::Option Identity{
+R"({
+    "names" : ["identity"],
+    "description" : "Subread identity to the insert, errors are half insertions and a quarter each deletions and substitutions.",
+    "type" : "float",
+    "default" : 0.88
+})"
+};
+const CLI_v2::Option LowComplexity{
+R"({
+    "names" : ["low-complexity"],
+    "description" : "Fraction of ZMWs whose insert is a short tandem repeat.",
+    "type" : "float",
+    "default" : 0.0
+})"
+};
+const CLI_v2::Option Seed{
+R"({
+    "names" : ["seed"],
+    "description" : "Seed of the random number generator.",
+    "type" : "int",
+    "default" : 42
+})"
+};
+// clang-format on
+}  // namespace OptionNames
+
+namespace {
+
+constexpr char MOVIE_NAME[] = "m00000_000000_000000";
+constexpr int32_t MIN_INSERT_LENGTH = 100;
+constexpr int32_t ADAPTER_LENGTH = 45;
+constexpr char BASES[] = "ACGT";
+
+struct SimulationSettings
+{
+    int32_t NumZmws;
+    int32_t InsertMean;
+    int32_t InsertSd;
+    int32_t Passes;
+    double Identity;
+    double LowComplexity;
+};
+
+CLI_v2::Interface CreateCLI()
+{
+    static const std::string description{
+        "Simulate subread and CCS BAM files with PBIs, OUT.subreads.bam and OUT.ccs.bam."};
+    CLI_v2::Interface i{"actc-simulate", description, Actc::LibraryInfo().Release};
+
+    const CLI_v2::PositionalArgument Prefix{
+        R"({
+        "name" : "OUT",
+        "description" : "Output prefix.",
+        "type" : "string",
+        "required" : true
+    })"};
+    i.AddPositionalArguments({Prefix});
+    i.AddOption(OptionNames::NumZmws);
+    i.AddOption(OptionNames::InsertMean);
+    i.AddOption(OptionNames::InsertSd);
+    i.AddOption(OptionNames::Passes);
+    i.AddOption(OptionNames::Identity);
+    i.AddOption(OptionNames::LowComplexity);
+    i.AddOption(OptionNames::Seed);
+    return i;
+}
+
+std::string RandomInsert(const SimulationSettings& settings, std::mt19937_64& rng)
+{
+    // Log-normal with the requested mean and standard deviation, the
+    // distribution needs a positive one
+    int32_t length = settings.InsertMean;
+    if (settings.InsertSd > 0) {
+        const double mean = settings.InsertMean;
+        const double sd = settings.InsertSd;
+        const double sigma2 = std::log(1.0 + (sd * sd) / (mean * mean));
+        std::lognormal_distribution<double> lengthDist{std::log(mean) - sigma2 / 2,
+                                                       std::sqrt(sigma2)};
+        length = std::max<int32_t>(MIN_INSERT_LENGTH, std::lround(lengthDist(rng)));
+    }
+
+    std::uniform_int_distribution<int32_t> baseDist{0, 3};
+    std::string insert(length, 'A');
+    if (std::bernoulli_distribution{settings.LowComplexity}(rng)) {
+        std::uniform_int_distribution<int32_t> unitDist{1, 6};
+        std::string unit(unitDist(rng), 'A');
+        for (char& base : unit) {
+            base = BASES[baseDist(rng)];
+        }
+        for (int32_t i = 0; i < length; ++i) {
+            insert[i] = unit[i % unit.size()];
+        }
+    } else {
+        for (char& base : insert) {
+            base = BASES[baseDist(rng)];
+        }
+    }
+    return insert;
+}
+
+std::string AddErrors(const std::string& insert, const double identity, std::mt19937_64& rng)
+{
+    const double errorRate = 1.0 - identity;
+    std::bernoulli_distribution isError{errorRate};
+    std::uniform_int_distribution<int32_t> errorType{0, 3};
+    std::uniform_int_distribution<int32_t> baseDist{0, 3};
+    std::uniform_int_distribution<int32_t> otherBaseDist{1, 3};
+
+    std::string read;
+    read.reserve(insert.size() * (1 + errorRate));
+    for (const char base : insert) {
+        if (!isError(rng)) {
+            read.push_back(base);
+            continue;
+        }
+        switch (errorType(rng)) {
+            case 0:  // deletion
+                break;
+            case 1:  // substitution
+                read.push_back(
+                    BASES[(std::string_view{BASES}.find(base) + otherBaseDist(rng)) % 4]);
+                break;
+            default:  // insertion
+                read.push_back(BASES[baseDist(rng)]);
+                read.push_back(base);
+                break;
+        }
+    }
+    return read;
+}
+
+BAM::BamHeader CreateHeader(const std::string& readType)
+{
+    BAM::ReadGroupInfo readGroup{MOVIE_NAME, readType};
+    readGroup.BindingKit("101-894-200")
+        .SequencingKit("101-826-100")
+        .BasecallerVersion("5.0.0")
+        .FrameRateHz("100");
+
+    BAM::BamHeader header;
+    header.Version("1.6").SortOrder("unknown").PacBioBamVersion("5.0.0");
+    header.AddReadGroup(readGroup);
+    return header;
+}
+
+BAM::BamRecord CreateRecord(const std::string& name, const std::string& sequence,
+                            BAM::TagCollection tags, const std::string& readGroupId)
+{
+    BAM::BamRecordImpl impl;
+    impl.Name(name);
+    impl.SetSequenceAndQualities(sequence, std::string(sequence.size(), '5'));
+    impl.SetMapped(false);
+    tags["RG"] = readGroupId;
+    impl.Tags(tags);
+    return BAM::BamRecord{std::move(impl)};
+}
+
+int RunnerSubroutine(const CLI_v2::Results& options)
+{
+    const std::vector<std::string> files = options.PositionalArguments();
+    const std::string prefix = files[0];
+
+    SimulationSettings settings;
+    settings.NumZmws = options[OptionNames::NumZmws];
+    settings.InsertMean = options[OptionNames::InsertMean];
+    settings.InsertSd = options[OptionNames::InsertSd];
+    settings.Passes = options[OptionNames::Passes];
+    settings.Identity = options[OptionNames::Identity];
+    settings.LowComplexity = options[OptionNames::LowComplexity];
+    const int32_t seed = options[OptionNames::Seed];
+    if (settings.NumZmws <= 0 || settings.InsertMean < MIN_INSERT_LENGTH || settings.Passes <= 0) {
+        throw PB_CLI_ALARM("--zmws and --passes must be positive, --insert-mean at least " +
+                           std::to_string(MIN_INSERT_LENGTH));
+    }
+    if (settings.InsertSd < 0) {
+        throw PB_CLI_ALARM("--insert-sd must not be negative");
+    }
+    const auto IsFraction = [](const double value) { return value >= 0 && value <= 1; };
+    if (!IsFraction(settings.Identity) || !IsFraction(settings.LowComplexity)) {
+        throw PB_CLI_ALARM("--identity and --low-complexity must be between 0 and 1");
+    }
+
+    const BAM::BamHeader subreadHeader = CreateHeader("SUBREAD");
+    const BAM::BamHeader ccsHeader = CreateHeader("CCS");
+    const std::string subreadRg = subreadHeader.ReadGroups().front().Id();
+    const std::string ccsRg = ccsHeader.ReadGroups().front().Id();
+    const std::string subreadFile = prefix + ".subreads.bam";
+    const std::string ccsFile = prefix + ".ccs.bam";
+
+    std::mt19937_64 rng{static_cast<uint64_t>(seed)};
+    std::poisson_distribution<int32_t> passDist{static_cast<double>(settings.Passes)};
+    int64_t numSubreads = 0;
+    {
+        BAM::BamWriter subreadWriter{subreadFile, subreadHeader};
+        BAM::BamWriter ccsWriter{ccsFile, ccsHeader};
+        for (int32_t holeNumber = 0; holeNumber < settings.NumZmws; ++holeNumber) {
+            const std::string insert = RandomInsert(settings, rng);
+            const std::string revInsert = Utility::ReverseComplemented(insert);
+            const int32_t numPasses = std::max(1, passDist(rng));
+            const std::string zmwName = std::string{MOVIE_NAME} + '/' + std::to_string(holeNumber);
+
+            int32_t qStart = 0;
+            for (int32_t pass = 0; pass < numPasses; ++pass) {
+                const std::string subread =
+                    AddErrors(pass % 2 == 0 ? insert : revInsert, settings.Identity, rng);
+                const int32_t qEnd = qStart + subread.size();
+                BAM::TagCollection tags;
+                tags["zm"] = holeNumber;
+                tags["qs"] = qStart;
+                tags["qe"] = qEnd;
+                tags["np"] = 1;
+                tags["rq"] = static_cast<float>(settings.Identity);
+                subreadWriter.Write(CreateRecord(
+                    zmwName + '/' + std::to_string(qStart) + '_' + std::to_string(qEnd), subread,
+                    std::move(tags), subreadRg));
+                qStart = qEnd + ADAPTER_LENGTH;
+                ++numSubreads;
+            }
+
+            BAM::TagCollection tags;
+            tags["zm"] = holeNumber;
+            tags["np"] = numPasses;
+            tags["rq"] = 0.999F;
+            ccsWriter.Write(CreateRecord(zmwName + "/ccs", insert, std::move(tags), ccsRg));
+        }
+    }
+    BAM::BamFile{subreadFile}.CreatePacBioIndex();
+    BAM::BamFile{ccsFile}.CreatePacBioIndex();
+
+    PBLOG_INFO << "Wrote " << settings.NumZmws << " ZMWs and " << numSubreads << " subreads to "
+               << subreadFile << " and " << ccsFile;
+    return EXIT_SUCCESS;
+}
+
+}  // namespace
+}  // namespace PacBio
+
+int main(int argc, char* argv[])
+{
+    return PacBio::CLI_v2::Run(argc, argv, PacBio::CreateCLI(), &PacBio::RunnerSubroutine);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace PacBio {
+
+struct SubreadAlignerConfig
+{
+    // Derive bandwidth and z-drop from the CCS and subread lengths
+    bool AutoBandwidth{false};
+    // Map subreads only in the orientation predicted by pass alternation
+    bool PredictStrand{false};
+    // Skip secondary and supplementary chains before alignment
+    bool PrimaryOnly{false};
+    // Cheap settings after a ZMW exceeded its time budget: narrowest band,
+    // primary chains only and no realignment of truncated alignments
+    bool Fallback{false};
+};
+
+}  // namespace PacBio
@@ -0,0 +1,143 @@
+#include "ThreadBudget.hpp"
+
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace PacBio {
+namespace {
+
+// Parses a sysfs CPU list like "0-3,8-11"
+std::vector<int32_t> ParseCpuList(const std::string& cpuList)
+{
+    std::vector<int32_t> cpus;
+    std::size_t pos = 0;
+    while (pos < cpuList.size()) {
+        std::size_t end = cpuList.find(',', pos);
+        if (end == std::string::npos) {
+            end = cpuList.size();
+        }
+        const std::string range = cpuList.substr(pos, end - pos);
+        const std::size_t dash = range.find('-');
+        try {
+            const int32_t first = std::stoi(range.substr(0, dash));
+            const int32_t last =
+                dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int32_t cpu = first; cpu <= last; ++cpu) {
+                cpus.emplace_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // Ignore malformed entries
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+}  // namespace
+
+ThreadBudget SplitThreadBudget(const int32_t numThreads, const int32_t decompression,
+                               const int32_t alignment, const int32_t compression)
+{
+    if (decompression < 0 || alignment < 0 || compression < 0) {
+        throw PB_CLI_ALARM("Thread counts per stage must be positive, or 0 for automatic.");
+    }
+
+    // Alignment dominates the runtime, BGZF stages get a small share each
+    ThreadBudget budget;
+    budget.Decompression = decompression > 0 ? decompression : std::clamp(numThreads / 8, 1, 8);
+    budget.Compression = compression > 0 ? compression : std::clamp(numThreads / 4, 1, 16);
+    budget.Alignment = alignment > 0
+                           ? alignment
+                           : std::max(1, numThreads - budget.Decompression - budget.Compression);
+
+    const int32_t total = budget.Decompression + budget.Alignment + budget.Compression;
+    if (total > numThreads && (decompression > 0 || alignment > 0 || compression > 0)) {
+        PBLOG_BLOCK_WARN("Threads", "Stage thread counts sum to " + std::to_string(total) +
+                                        ", more than the " + std::to_string(numThreads) +
+                                        " threads of -j");
+    }
+    return budget;
+}
+
+std::vector<int32_t> CpusByNumaNode()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return {};
+    }
+    const auto isAllowed = [&allowed](const int32_t cpu) {
+        return cpu >= 0 && cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed);
+    };
+
+    // Nodes in numeric order, CPUs of one node are adjacent
+    std::vector<int32_t> nodes;
+    const std::filesystem::path nodeDir{"/sys/devices/system/node"};
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator{nodeDir, ec}) {
+        const std::string name = entry.path().filename().string();
+        if (name.starts_with("node") && name.size() > 4 &&
+            std::all_of(name.cbegin() + 4, name.cend(), ::isdigit)) {
+            nodes.emplace_back(std::stoi(name.substr(4)));
+        }
+    }
+    std::sort(nodes.begin(), nodes.end());
+
+    std::vector<int32_t> cpus;
+    for (const int32_t node : nodes) {
+        std::ifstream in{nodeDir / ("node" + std::to_string(node)) / "cpulist"};
+        std::string cpuList;
+        std::getline(in, cpuList);
+        for (const int32_t cpu : ParseCpuList(cpuList)) {
+            if (isAllowed(cpu) && std::find(cpus.cbegin(), cpus.cend(), cpu) == cpus.cend()) {
+                cpus.emplace_back(cpu);
+            }
+        }
+    }
+
+    // Without NUMA information, use the affinity mask as is
+    if (cpus.empty()) {
+        for (int32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (isAllowed(cpu)) {
+                cpus.emplace_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+CpuPinner::CpuPinner() : cpus_{CpusByNumaNode()}
+{
+    if (cpus_.empty()) {
+        PBLOG_BLOCK_WARN("Threads", "Could not determine CPUs, threads are not pinned");
+    }
+}
+
+void CpuPinner::PinCurrentThread()
+{
+    thread_local bool pinned = false;
+    if (pinned || cpus_.empty()) {
+        return;
+    }
+    pinned = true;
+
+    const int32_t cpu = cpus_[nextSlot_++ % cpus_.size()];
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+        PBLOG_BLOCK_WARN("Threads", "Could not pin thread to CPU " + std::to_string(cpu));
+        return;
+    }
+    PBLOG_BLOCK_DEBUG("Threads", "Pinned thread to CPU " + std::to_string(cpu));
+}
+
+}  // namespace PacBio
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace PacBio {
+
+// Threads per pipeline stage, all stages run concurrently
+struct ThreadBudget
+{
+    // BGZF decompression of the inputs
+    int32_t Decompression{1};
+    // Alignment workers
+    int32_t Alignment{1};
+    // BGZF compression of the output
+    int32_t Compression{1};
+};
+
+// Splits numThreads across the stages. Stage counts greater than 0 are taken
+// as given, the others are derived from the remaining budget.
+ThreadBudget SplitThreadBudget(int32_t numThreads, int32_t decompression, int32_t alignment,
+                               int32_t compression);
+
+// Usable CPUs of this process, grouped by NUMA node
+std::vector<int32_t> CpusByNumaNode();
+
+// Pins each calling thread to its own CPU, filling one NUMA node after the other
+class CpuPinner
+{
+public:
+    CpuPinner();
+
+    // Pins the calling thread on its first call, later calls are no-ops
+    void PinCurrentThread();
+
+private:
+    std::vector<int32_t> cpus_;
+    std::atomic<int32_t> nextSlot_{0};
+};
+
+}  // namespace PacBio
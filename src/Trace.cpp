@@ -0,0 +1,104 @@
+#include "Trace.hpp"
+
+#include <pbcopper/utility/Alarm.h>
+
+#include <atomic>
+#include <sstream>
+
+namespace PacBio {
+namespace {
+
+// Events kept in memory before they are written
+constexpr std::size_t TRACE_BUFFER_SIZE = 4096;
+
+int32_t CurrentThreadId()
+{
+    static std::atomic<int32_t> numThreads{0};
+    thread_local const int32_t id = numThreads++;
+    return id;
+}
+
+std::string JsonEscaped(const std::string& value)
+{
+    std::string result;
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            result.push_back('\\');
+        }
+        result.push_back(c);
+    }
+    return result;
+}
+
+}  // namespace
+
+TraceWriter::TraceWriter(const std::string& filename)
+    : origin_{std::chrono::steady_clock::now()}, out_{filename}
+{
+    if (!out_) {
+        throw PB_CLI_ALARM("Could not open trace file " + filename);
+    }
+    buffer_.reserve(TRACE_BUFFER_SIZE);
+    out_ << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (ActiveTrace() == this) {
+        SetActiveTrace(nullptr);
+    }
+    std::lock_guard<std::mutex> lock{mutex_};
+    FlushBuffer();
+    out_ << "\n]}\n";
+}
+
+int64_t TraceWriter::Now() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                 origin_)
+        .count();
+}
+
+void TraceWriter::AddSpan(const char* name, const int32_t holeNumber, const int64_t start,
+                          const int64_t end)
+{
+    std::ostringstream event;
+    event << R"({"name":")" << name << R"(","cat":"zmw","ph":"X","pid":1,"tid":)"
+          << CurrentThreadId() << R"(,"ts":)" << start << R"(,"dur":)" << (end - start);
+    if (holeNumber >= 0) {
+        event << R"(,"args":{"zmw":)" << holeNumber << '}';
+    }
+    event << '}';
+    WriteEvent(event.str());
+}
+
+void TraceWriter::NameCurrentThread(const std::string& name)
+{
+    std::ostringstream event;
+    event << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << CurrentThreadId()
+          << R"(,"args":{"name":")" << JsonEscaped(name) << R"("}})";
+    WriteEvent(event.str());
+}
+
+void TraceWriter::WriteEvent(const std::string& event)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    buffer_.emplace_back(event);
+    if (buffer_.size() >= TRACE_BUFFER_SIZE) {
+        FlushBuffer();
+    }
+}
+
+void TraceWriter::FlushBuffer()
+{
+    for (const std::string& event : buffer_) {
+        if (!firstEvent_) {
+            out_ << ",\n";
+        }
+        out_ << event;
+        firstEvent_ = false;
+    }
+    buffer_.clear();
+}
+
+}  // namespace PacBio
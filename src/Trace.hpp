@@ -0,0 +1,40 @@
+#pragma once
+
+#include "TraceSpan.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace PacBio {
+
+// Spans in Chrome trace event format, viewable in chrome://tracing or
+// Perfetto. Events are buffered and streamed to the file, threads are numbered
+// in order of their first event. The writer deactivates itself when destroyed.
+class TraceWriter final : public TraceSink
+{
+public:
+    explicit TraceWriter(const std::string& filename);
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    ~TraceWriter() override;
+
+    int64_t Now() const override;
+    void AddSpan(const char* name, int32_t holeNumber, int64_t start, int64_t end) override;
+    void NameCurrentThread(const std::string& name) override;
+
+private:
+    void WriteEvent(const std::string& event);
+    void FlushBuffer();
+
+    const std::chrono::steady_clock::time_point origin_;
+    std::mutex mutex_;
+    std::ofstream out_;
+    std::vector<std::string> buffer_;
+    bool firstEvent_{true};
+};
+
+}  // namespace PacBio
@@ -0,0 +1,16 @@
+#include "TraceSpan.hpp"
+
+#include <atomic>
+
+namespace PacBio {
+namespace {
+
+std::atomic<TraceSink*> activeTrace{nullptr};
+
+}  // namespace
+
+TraceSink* ActiveTrace() { return activeTrace.load(std::memory_order_relaxed); }
+
+void SetActiveTrace(TraceSink* trace) { activeTrace.store(trace); }
+
+}  // namespace PacBio
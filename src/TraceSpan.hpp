@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace PacBio {
+
+// Receiver of the spans recorded while aligning, the actc executable writes
+// them as a trace file
+class TraceSink
+{
+public:
+    virtual ~TraceSink() = default;
+
+    // Microseconds since the sink was created
+    virtual int64_t Now() const = 0;
+
+    // Span of a ZMW stage on the calling thread, a negative hole number is
+    // omitted
+    virtual void AddSpan(const char* name, int32_t holeNumber, int64_t start, int64_t end) = 0;
+
+    // Label of the calling thread in the viewer
+    virtual void NameCurrentThread(const std::string& name) = 0;
+};
+
+// Tracing is off while no sink is active
+TraceSink* ActiveTrace();
+void SetActiveTrace(TraceSink* trace);
+
+// Records the span from construction to destruction if tracing is on,
+// otherwise costs a single pointer load
+class TraceSpan
+{
+public:
+    TraceSpan(const char* name, const int32_t holeNumber)
+        : trace_{ActiveTrace()}, name_{name}, holeNumber_{holeNumber}
+    {
+        if (trace_) {
+            start_ = trace_->Now();
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan()
+    {
+        if (trace_) {
+            trace_->AddSpan(name_, holeNumber_, start_, trace_->Now());
+        }
+    }
+
+private:
+    TraceSink* const trace_;
+    const char* const name_;
+    const int32_t holeNumber_;
+    int64_t start_{0};
+};
+
+}  // namespace PacBio
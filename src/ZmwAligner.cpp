@@ -0,0 +1,255 @@
+#include "ZmwAligner.hpp"
+
+#include "AlignerUtils.hpp"
+#include "PancakeAligner.hpp"
+#include "TraceSpan.hpp"
+
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/parallel/WorkQueue.h>
+#include <pbcopper/utility/Ssize.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace PacBio {
+
+void WriteZmwStatsHeader(std::ostream& out)
+{
+    out << "hole_number\tccs_length\tsubreads\tsubreads_aligned\tbases_aligned\tmean_identity"
+           "\tmap_align_ms\ttime_budget\n";
+}
+
+void WriteZmwStats(std::ostream& out, const ZmwStats& stats)
+{
+    out << stats.HoleNumber << '\t' << stats.CcsLength << '\t' << stats.NumSubreads << '\t'
+        << stats.NumAligned << '\t' << stats.AlignedBases << '\t' << std::fixed
+        << std::setprecision(4) << stats.MeanIdentity << '\t' << std::setprecision(3)
+        << stats.AlignMilliseconds << '\t';
+    switch (stats.Budget) {
+        case ZmwBudget::WITHIN:
+            out << "ok";
+            break;
+        case ZmwBudget::FALLBACK:
+            out << "fallback";
+            break;
+        case ZmwBudget::ABANDONED:
+            out << "abandoned";
+            break;
+    }
+    out << '\n';
+}
+
+ZmwOutput AlignZmw(const ZmwInput& zmw, const ZmwAlignerSettings& settings,
+                   const BAM::BamHeader* header)
+{
+    ZmwOutput result;
+    if (zmw.CcsRecords.empty()) {
+        return result;
+    }
+
+    const int32_t holeNumber = zmw.CcsRecords[0].HoleNumber();
+
+    // Each sequence is decoded once, subreads feed mapping and output
+    std::vector<std::string> ccsSeqs(zmw.CcsRecords.size());
+    std::vector<std::string> clrSeqs(zmw.SubreadRecords.size());
+    {
+        const TraceSpan span{"decode", holeNumber};
+        for (int32_t i = 0; i < std::ssize(zmw.CcsRecords); ++i) {
+            const int32_t ccsLength = zmw.CcsRecords[i].Impl().SequenceLength();
+            if (settings.TrimFlanksBp < 0 || 2 * settings.TrimFlanksBp >= ccsLength) {
+                throw std::runtime_error{"Cannot trim " + std::to_string(settings.TrimFlanksBp) +
+                                         " bp from each flank of CCS read " +
+                                         zmw.CcsRecords[i].FullName() + " with length " +
+                                         std::to_string(ccsLength)};
+            }
+            DecodeSequence(zmw.CcsRecords[i], settings.TrimFlanksBp,
+                           ccsLength - settings.TrimFlanksBp, ccsSeqs[i]);
+        }
+        for (int32_t i = 0; i < std::ssize(zmw.SubreadRecords); ++i) {
+            DecodeSequence(zmw.SubreadRecords[i], 0, zmw.SubreadRecords[i].Impl().SequenceLength(),
+                           clrSeqs[i]);
+        }
+    }
+
+    // Pancake maps and aligns in one call
+    {
+        const TraceSpan span{"map and align", holeNumber};
+        const auto start = std::chrono::steady_clock::now();
+        const auto Align = [&](const SubreadAlignerConfig& config) {
+            return ccsSeqs.size() == 2
+                       ? PancakeAlignerByStrand(clrSeqs, ccsSeqs[0], ccsSeqs[1], config)
+                       : PancakeAlignerSubread(clrSeqs, ccsSeqs[0], config);
+        };
+        if (settings.MaxZmwSeconds <= 0) {
+            result.Alignments = Align(settings.AlignerConfig);
+        } else {
+            bool exceeded = false;
+            {
+                const AlignmentDeadline deadline{settings.MaxZmwSeconds};
+                result.Alignments = Align(settings.AlignerConfig);
+                exceeded = deadline.Exceeded();
+            }
+            if (exceeded) {
+                // Partial results are discarded, strand assignment and band
+                // of the fallback apply to the whole ZMW
+                PBLOG_DEBUG << "ZMW " << holeNumber << " exceeded its time budget, realigning";
+                SubreadAlignerConfig fallback = settings.AlignerConfig;
+                fallback.Fallback = true;
+                const AlignmentDeadline deadline{settings.MaxZmwSeconds};
+                result.Alignments = Align(fallback);
+                result.Stats.Budget =
+                    deadline.Exceeded() ? ZmwBudget::ABANDONED : ZmwBudget::FALLBACK;
+            }
+        }
+        result.Stats.AlignMilliseconds =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+    }
+
+    ZmwStats& stats = result.Stats;
+    stats.HoleNumber = holeNumber;
+    stats.CcsLength = ccsSeqs[0].size();
+    stats.NumSubreads = clrSeqs.size();
+    int32_t numPrimary = 0;
+
+    const TraceSpan span{"convert", holeNumber};
+    int32_t subreadIdx = 0;
+    for (auto& aln : result.Alignments) {
+        // Primary-only mapper settings drop all other chains before alignment
+        assert(!settings.AlignerConfig.PrimaryOnly ||
+               std::none_of(aln.cbegin(), aln.cend(),
+                            [](const auto& a) { return a->isSecondary || a->isSupplementary; }));
+        bool aligned = false;
+        for (const auto& a : aln) {
+            if (!a->isAligned || a->isSecondary) {
+                continue;
+            }
+            aligned = true;
+            stats.AlignedBases += a->qEnd - a->qStart;
+            if (!a->isSupplementary) {
+                stats.MeanIdentity += CalcAlignmentIdentity(a->cigar);
+                ++numPrimary;
+            }
+        }
+        stats.NumAligned += aligned;
+
+        if (header) {
+            for (const auto& a : aln) {
+                if (a->isAligned) {
+                    result.Records.emplace_back(AlnToBam(
+                        zmw.FirstRefId + a->rId, *header, *a, zmw.SubreadRecords[subreadIdx],
+                        clrSeqs[subreadIdx], settings.CcsQuery, settings.Tags));
+                }
+            }
+        }
+        ++subreadIdx;
+    }
+    if (numPrimary > 0) {
+        stats.MeanIdentity /= numPrimary;
+    }
+    if (settings.SortRecords) {
+        std::stable_sort(result.Records.begin(), result.Records.end(),
+                         [](const BAM::BamRecord& a, const BAM::BamRecord& b) {
+                             return std::make_pair(a.ReferenceId(), a.ReferenceStart()) <
+                                    std::make_pair(b.ReferenceId(), b.ReferenceStart());
+                         });
+    }
+    return result;
+}
+
+struct ZmwAligner::Impl
+{
+    Impl(ZmwAlignerSettings settings, std::optional<BAM::BamHeader> header, Sink sink)
+        : Settings{std::move(settings)}
+        , Header{std::move(header)}
+        , Queue{std::max(1, Settings.NumThreads), 10}
+    {
+        Consumer = std::async(std::launch::async, [this, sink = std::move(sink)]() {
+            // After the first error, outputs are drained without the sink, so
+            // Submit never blocks on a full queue
+            bool failed = false;
+            const auto Consume = [&](ZmwOutput&& output) {
+                if (!failed) {
+                    sink(std::move(output));
+                }
+            };
+            while (true) {
+                try {
+                    if (!Queue.ConsumeWith(Consume)) {
+                        break;
+                    }
+                } catch (...) {
+                    if (!failed) {
+                        failed = true;
+                        const std::lock_guard<std::mutex> lock{ErrorMutex};
+                        Error = std::current_exception();
+                    }
+                }
+            }
+        });
+    }
+
+    void RethrowError()
+    {
+        const std::lock_guard<std::mutex> lock{ErrorMutex};
+        if (Error) {
+            std::rethrow_exception(Error);
+        }
+    }
+
+    const ZmwAlignerSettings Settings;
+    const std::optional<BAM::BamHeader> Header;
+    Parallel::WorkQueue<ZmwOutput> Queue;
+    std::future<void> Consumer;
+    std::mutex ErrorMutex;
+    std::exception_ptr Error;
+    bool Finished{false};
+};
+
+ZmwAligner::ZmwAligner(ZmwAlignerSettings settings, std::optional<BAM::BamHeader> header, Sink sink)
+    : impl_{std::make_unique<Impl>(std::move(settings), std::move(header), std::move(sink))}
+{
+}
+
+ZmwAligner::~ZmwAligner()
+{
+    try {
+        Finish();
+    } catch (const std::exception& e) {
+        PBLOG_ERROR << "ZMW aligner: " << e.what();
+    }
+}
+
+void ZmwAligner::Submit(ZmwInput zmw)
+{
+    impl_->RethrowError();
+
+    const auto Align = [this](ZmwInput& input) {
+        return AlignZmw(input, impl_->Settings, impl_->Header ? &*impl_->Header : nullptr);
+    };
+    impl_->Queue.ProduceWith(Align, std::move(zmw));
+}
+
+void ZmwAligner::Finish()
+{
+    if (impl_->Finished) {
+        return;
+    }
+    impl_->Finished = true;
+    impl_->Queue.FinalizeWorkers();
+    impl_->Consumer.wait();
+    impl_->Queue.Finalize();
+    impl_->Consumer.get();
+    impl_->RethrowError();
+}
+
+}  // namespace PacBio
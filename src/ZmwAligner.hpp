@@ -0,0 +1,113 @@
+#pragma once
+
+#include "AlignmentResult.hpp"
+#include "SubreadAlignerConfig.hpp"
+
+#include <pbbam/BamHeader.h>
+#include <pbbam/BamRecord.h>
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace PacBio {
+
+struct ZmwAlignerSettings
+{
+    int32_t NumThreads{1};
+    // Trim N bp from each flank of the CCS before alignment
+    int32_t TrimFlanksBp{0};
+    // References are CCS reads, not subreads
+    bool CcsQuery{false};
+    SubreadAlignerConfig AlignerConfig;
+    TagFilter Tags;
+    // Time budget for mapping and aligning one ZMW, 0 for none. A ZMW over
+    // budget is realigned with fallback settings under a fresh budget, if that
+    // is exceeded too the remaining subreads stay unaligned.
+    double MaxZmwSeconds{0};
+    // Order records by reference and position. All references of a ZMW are
+    // consecutive, so ZMWs written in CCS order give a coordinate-sorted file.
+    bool SortRecords{false};
+};
+
+enum class ZmwBudget
+{
+    WITHIN,
+    FALLBACK,
+    ABANDONED,
+};
+
+// One CCS ZMW, a by-strand ZMW has two CCS records
+struct ZmwInput
+{
+    std::vector<BAM::BamRecord> CcsRecords;
+    std::vector<BAM::BamRecord> SubreadRecords;
+    // Reference id of the first CCS record in the output header
+    int32_t FirstRefId{0};
+};
+
+// Summary of one aligned ZMW. Bases count primary and supplementary
+// alignments, the identity is averaged over primary alignments.
+struct ZmwStats
+{
+    int32_t HoleNumber{-1};
+    // First CCS record after trimming, the forward strand of by-strand ZMWs
+    int32_t CcsLength{0};
+    int32_t NumSubreads{0};
+    int32_t NumAligned{0};
+    int64_t AlignedBases{0};
+    double MeanIdentity{0};
+    // Mapping and alignment, pancake runs both in one call
+    double AlignMilliseconds{0};
+    ZmwBudget Budget{ZmwBudget::WITHIN};
+};
+
+// Tab-separated, one ZMW per line
+void WriteZmwStatsHeader(std::ostream& out);
+void WriteZmwStats(std::ostream& out, const ZmwStats& stats);
+
+struct ZmwOutput
+{
+    // One entry per subread, in input order
+    std::vector<AlnResults> Alignments;
+    // Aligned BAM records, only filled if a header was given
+    std::vector<BAM::BamRecord> Records;
+    ZmwStats Stats;
+};
+
+// Aligns one ZMW on the calling thread. Mappers are reused across calls.
+ZmwOutput AlignZmw(const ZmwInput& zmw, const ZmwAlignerSettings& settings,
+                   const BAM::BamHeader* header);
+
+// Streaming front end for embedding actc. ZMWs are aligned on the configured
+// number of threads, the sink is called on a single thread with the outputs
+// in submission order.
+class ZmwAligner
+{
+public:
+    using Sink = std::function<void(ZmwOutput&&)>;
+
+    // Without a header only AlignmentResults are produced
+    ZmwAligner(ZmwAlignerSettings settings, std::optional<BAM::BamHeader> header, Sink sink);
+    ZmwAligner(const ZmwAligner&) = delete;
+    ZmwAligner& operator=(const ZmwAligner&) = delete;
+    ~ZmwAligner();
+
+    // Blocks while too many ZMWs are in flight. Rethrows the first error from
+    // alignment or the sink, ZMWs submitted after it are not passed to the sink.
+    void Submit(ZmwInput zmw);
+
+    // Waits for all submitted ZMWs to reach the sink, rethrows errors from
+    // alignment or the sink
+    void Finish();
+
+private:
+    // Keeps pancake and the work queue out of the installed headers
+    struct Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+}  // namespace PacBio
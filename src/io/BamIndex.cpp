@@ -0,0 +1,79 @@
+#include "BamIndex.hpp"
+
+#include <pbbam/PbiRawData.h>
+#include <pbcopper/utility/Alarm.h>
+
+#include <htslib/hts.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace PacBio {
+namespace IO {
+namespace {
+
+// Bin sizes of BAI, CSI keeps the smallest bin and adds levels as needed
+constexpr int MIN_SHIFT = 14;
+constexpr int BAI_LEVELS = 5;
+constexpr int64_t MAX_BAI_REFERENCE_LENGTH = int64_t{1} << 29;
+// Empty BGZF block closing every BAM file
+constexpr std::uintmax_t BGZF_EOF_SIZE = 28;
+
+struct IndexDeleter
+{
+    void operator()(hts_idx_t* index) const { hts_idx_destroy(index); }
+};
+
+}  // namespace
+
+void IndexSortedBam(const BAM::BamFile& bamFile)
+{
+    const std::string& filename = bamFile.Filename();
+    int64_t maxLength = 0;
+    for (const auto& sequence : bamFile.Header().Sequences()) {
+        maxLength = std::max<int64_t>(maxLength, std::stoll(sequence.Length()));
+    }
+    const bool csi = maxLength >= MAX_BAI_REFERENCE_LENGTH;
+    int numLevels = BAI_LEVELS;
+    if (csi) {
+        numLevels = 0;
+        for (int64_t binSize = int64_t{1} << MIN_SHIFT; binSize < maxLength; binSize <<= 3) {
+            ++numLevels;
+        }
+    }
+
+    const BAM::PbiRawData pbi{bamFile.PacBioIndexFilename()};
+    const auto& fileOffsets = pbi.BasicData().fileOffset_;
+    const int64_t numRecords = fileOffsets.size();
+    if (numRecords > 0 && !pbi.HasMappedData()) {
+        throw PB_ALARM("OutputDataError", "PBI of " + filename + " lacks reference positions");
+    }
+    // Records end where the next one starts, the last one at the EOF block
+    const uint64_t endOffset = (std::filesystem::file_size(filename) - BGZF_EOF_SIZE) << 16;
+    const uint64_t firstOffset = numRecords > 0 ? fileOffsets[0] : endOffset;
+
+    const int format = csi ? HTS_FMT_CSI : HTS_FMT_BAI;
+    const std::unique_ptr<hts_idx_t, IndexDeleter> index{hts_idx_init(
+        bamFile.Header().Sequences().size(), format, firstOffset, MIN_SHIFT, numLevels)};
+    if (!index) {
+        throw PB_ALARM("OutputDataError", "Could not create index for " + filename);
+    }
+    const auto& mapped = pbi.MappedData();
+    for (int64_t i = 0; i < numRecords; ++i) {
+        const uint64_t nextOffset = i + 1 < numRecords ? fileOffsets[i + 1] : endOffset;
+        if (hts_idx_push(index.get(), mapped.tId_[i], mapped.tStart_[i], mapped.tEnd_[i],
+                         nextOffset, mapped.tId_[i] >= 0) != 0) {
+            throw PB_ALARM("OutputDataError", "Cannot index " + filename + ", it is not sorted");
+        }
+    }
+    if (hts_idx_finish(index.get(), endOffset) != 0 ||
+        hts_idx_save_as(index.get(), filename.c_str(), nullptr, format) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not write index of " + filename);
+    }
+}
+
+}  // namespace IO
+}  // namespace PacBio
@@ -0,0 +1,17 @@
+#ifndef Actc_IO_BAMINDEX_HPP
+#define Actc_IO_BAMINDEX_HPP
+
+#include <pbbam/BamFile.h>
+
+namespace PacBio {
+namespace IO {
+
+// Writes the BAI of a coordinate-sorted BAM from its PBI, which holds the
+// virtual offset and reference span of every record, so no record is read.
+// If a reference exceeds the 2^29 bp limit of BAI, a CSI is written instead.
+void IndexSortedBam(const BAM::BamFile& bamFile);
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_BAMINDEX_HPP
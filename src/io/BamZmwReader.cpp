@@ -1,15 +1,24 @@
 #include "BamZmwReader.hpp"
 
+#include "ZmwOffsetIndex.hpp"
 #include "ZmwRecords.hpp"
 
 #include <pbbam/BamReader.h>
 #include <pbbam/PbiFilterQuery.h>
+#include <pbbam/PbiRawData.h>
+#include <pbbam/ReadGroupInfo.h>
 #include <pbcopper/logging/Logging.h>
 #include <pbcopper/utility/Alarm.h>
 
 #include <boost/algorithm/string/predicate.hpp>
 
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <numeric>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 namespace PacBio {
@@ -18,31 +27,30 @@ namespace {
 
 struct UniqueZmw
 {
+    std::int32_t FileIdx;
     std::int32_t PbiIdx;
     std::int32_t HoleNumber;
     std::int64_t FileOffset;
+    std::int32_t ReadGroupId;
+    // Summed query lengths of all records of this ZMW
+    std::int64_t Bases;
 };
 
-// Get the unique ZMWs from the input dataset, applying filters
+// Get the unique ZMWs from the input dataset, applying filters. ZMWs of
+// multiple BAM files are listed file after file.
 std::vector<UniqueZmw> UniqueZmws(const BAM::DataSet& ds, const bool dieOnError)
 {
     const std::vector<BAM::BamFile> bamFiles = ds.BamFiles();
-    // Only works with ONE input BAM file
-    if (std::ssize(bamFiles) != 1) {
-        if (dieOnError) {
-            throw PB_CLI_ALARM("Chunking only works with one input BAM file!");
-        } else {
-            return {};
-        }
-    }
 
-    // Input BAM file must have a PBI
-    if (!bamFiles[0].PacBioIndexExists()) {
-        if (dieOnError) {
-            throw PB_CLI_ALARM(
-                "PBI file is missing for input BAM file! Please create one using pbindex!");
-        } else {
-            return {};
+    // Input BAM files must have a PBI
+    for (const BAM::BamFile& bamFile : bamFiles) {
+        if (!bamFile.PacBioIndexExists()) {
+            if (dieOnError) {
+                throw PB_CLI_ALARM("PBI file is missing for input BAM file " + bamFile.Filename() +
+                                   "! Please create one using pbindex!");
+            } else {
+                return {};
+            }
         }
     }
 
@@ -137,47 +145,189 @@ std::vector<UniqueZmw> UniqueZmws(const BAM::DataSet& ds, const bool dieOnError)
         PBLOG_BLOCK_INFO("ZMW downsample", std::to_string(factor) + '%');
     }
 
-    const BAM::PbiRawData index{bamFiles[0].PacBioIndexFilename()};
-    const std::vector<std::int32_t>& zmws = index.BasicData().holeNumber_;
-    const std::vector<std::int64_t>& fileOffset = index.BasicData().fileOffset_;
-    const std::int32_t numRecords = std::ssize(zmws);
-    if (numRecords == 0) {
-        throw PB_ALARM("InputDataError", "No input records in PBI file!");
-    }
-
-    // Get the first record per ZMW
     std::vector<UniqueZmw> result;
-    result.reserve(numRecords);
-    if (zmwFilter.Accepts(index, 0)) {
-        result.emplace_back(UniqueZmw{0, zmws[0], fileOffset[0]});
-    }
-    for (std::int32_t i = 1; i < numRecords; ++i) {
-        if (zmws[i] != zmws[i - 1] && zmwFilter.Accepts(index, i)) {
-            result.emplace_back(UniqueZmw{i, zmws[i], fileOffset[i]});
+    for (std::int32_t fileIdx = 0; fileIdx < std::ssize(bamFiles); ++fileIdx) {
+        const BAM::PbiRawData index{bamFiles[fileIdx].PacBioIndexFilename()};
+        const std::vector<std::int32_t>& zmws = index.BasicData().holeNumber_;
+        const std::vector<std::int64_t>& fileOffset = index.BasicData().fileOffset_;
+        const std::int32_t numRecords = std::ssize(zmws);
+        if (numRecords == 0) {
+            throw PB_ALARM("InputDataError",
+                           "No input records in PBI file " + bamFiles[fileIdx].Filename() + '!');
+        }
+
+        const std::vector<std::int32_t>& readGroupIds = index.BasicData().rgId_;
+        const std::vector<std::int32_t>& qStart = index.BasicData().qStart_;
+        const std::vector<std::int32_t>& qEnd = index.BasicData().qEnd_;
+
+        // Get the first record per ZMW
+        result.reserve(result.size() + numRecords);
+        bool accepted = false;
+        for (std::int32_t i = 0; i < numRecords; ++i) {
+            if (i == 0 || zmws[i] != zmws[i - 1]) {
+                accepted = zmwFilter.Accepts(index, i);
+                if (accepted) {
+                    result.emplace_back(
+                        UniqueZmw{fileIdx, i, zmws[i], fileOffset[i], readGroupIds[i], 0});
+                }
+            }
+            if (accepted) {
+                result.back().Bases += std::max(0, qEnd[i] - qStart[i]);
+            }
         }
     }
 
 #ifndef NDEBUG
-    PBLOG_DEBUG << "I INDEX ZMW OFFSET START END";
+    PBLOG_DEBUG << "I FILE INDEX ZMW OFFSET";
     for (std::int32_t i = 0; i < std::ssize(result); ++i) {
-        PBLOG_DEBUG << i << ' ' << result[i].PbiIdx << ' ' << result[i].HoleNumber << ' '
-                    << result[i].FileOffset << ' ' << index.BasicData().qStart_[result[i].PbiIdx]
-                    << ' ' << index.BasicData().qEnd_[result[i].PbiIdx];
+        PBLOG_DEBUG << i << ' ' << result[i].FileIdx << ' ' << result[i].PbiIdx << ' '
+                    << result[i].HoleNumber << ' ' << result[i].FileOffset;
     }
 #endif
 
     return result;
 }
 
-// Create BAM reader for a given file path (might have filters) and configuration (might chunk)
+// Map read group IDs, as stored in the PBI, to their movie names
+std::unordered_map<std::int32_t, std::string> MoviesByReadGroupId(const BAM::BamFile& bamFile)
+{
+    std::unordered_map<std::int32_t, std::string> movies;
+    for (const BAM::ReadGroupInfo& readGroup : bamFile.Header().ReadGroups()) {
+        movies[BAM::ReadGroupInfo::IdToInt(readGroup.Id())] = readGroup.MovieName();
+    }
+    return movies;
+}
+
+// Estimate the alignment cost of each ZMW as its subread bases, which are all
+// aligned, plus its CCS bases, which are indexed as references
+std::vector<std::int64_t> EstimateZmwCosts(const BAM::DataSet& ccsDataset,
+                                           const std::vector<UniqueZmw>& zmws,
+                                           const std::string& subreadFile,
+                                           ZmwOffsetIndexCache& indices)
+{
+    if (subreadFile.empty()) {
+        throw PB_CLI_ALARM("--balance-chunks requires the subread input.");
+    }
+
+    // Subread ZMW indices per movie, each subread file holds a single movie
+    // and a movie may be split across files
+    std::unordered_map<std::string, std::vector<std::shared_ptr<const ZmwOffsetIndex>>>
+        subreadIndices;
+    for (const BAM::BamFile& bamFile : BAM::DataSet{subreadFile}.BamFiles()) {
+        if (!bamFile.PacBioIndexExists()) {
+            throw PB_CLI_ALARM("PBI file is missing for input BAM file " + bamFile.Filename() +
+                               "! Please create one using pbindex!");
+        }
+        const auto readGroups = bamFile.Header().ReadGroups();
+        if (readGroups.empty()) {
+            continue;
+        }
+        const std::string pbiFile = bamFile.PacBioIndexFilename();
+        subreadIndices[readGroups.front().MovieName()].emplace_back(indices.Get(pbiFile));
+    }
+
+    std::vector<std::unordered_map<std::int32_t, std::string>> ccsMovies;
+    for (const BAM::BamFile& bamFile : ccsDataset.BamFiles()) {
+        ccsMovies.emplace_back(MoviesByReadGroupId(bamFile));
+    }
+
+    std::vector<std::int64_t> costs;
+    costs.reserve(zmws.size());
+    std::int64_t numWithoutSubreads = 0;
+    for (const UniqueZmw& zmw : zmws) {
+        std::int64_t cost = zmw.Bases;
+        const auto movie = ccsMovies[zmw.FileIdx].find(zmw.ReadGroupId);
+        bool found = false;
+        if (movie != ccsMovies[zmw.FileIdx].cend()) {
+            const auto movieIndices = subreadIndices.find(movie->second);
+            if (movieIndices != subreadIndices.cend()) {
+                for (const auto& index : movieIndices->second) {
+                    if (const ZmwOffsetIndex::Entry* entry = index->Find(zmw.HoleNumber)) {
+                        cost += entry->Bases;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+        }
+        numWithoutSubreads += !found;
+        // Every ZMW costs at least reading it
+        costs.emplace_back(std::max<std::int64_t>(1, cost));
+    }
+    if (numWithoutSubreads > 0) {
+        PBLOG_BLOCK_WARN("Chunking", "ZMWs without subreads " + std::to_string(numWithoutSubreads));
+    }
+    return costs;
+}
+
+// Index of the first ZMW of each chunk, with one trailing entry past the last
+// ZMW. Boundaries are placed at equal cumulative cost and every chunk holds at
+// least one ZMW.
+std::vector<std::int32_t> BalancedChunkStarts(const std::vector<std::int64_t>& costs,
+                                              const std::int32_t numChunks)
+{
+    const std::int32_t numZmws = std::ssize(costs);
+    const std::int64_t totalCost = std::accumulate(costs.cbegin(), costs.cend(), std::int64_t{0});
+
+    std::vector<std::int32_t> starts(numChunks + 1);
+    starts[0] = 0;
+    starts[numChunks] = numZmws;
+    std::int32_t zmwIdx = 0;
+    std::int64_t cumulativeCost = 0;
+    for (std::int32_t chunk = 1; chunk < numChunks; ++chunk) {
+        const double targetCost = static_cast<double>(totalCost) * chunk / numChunks;
+        while (zmwIdx < numZmws && cumulativeCost + costs[zmwIdx] / 2.0 < targetCost) {
+            cumulativeCost += costs[zmwIdx];
+            ++zmwIdx;
+        }
+        const std::int32_t minStart = starts[chunk - 1] + 1;
+        const std::int32_t maxStart = numZmws - (numChunks - chunk);
+        starts[chunk] = std::clamp(zmwIdx, minStart, maxStart);
+    }
+    return starts;
+}
+
+// pbbam opens the readers of a filtered query itself, these take their BGZF
+// thread count from PB_BAMREADER_THREADS only
+std::unique_ptr<BAM::internal::IQuery> CreateFilterQuery(const BAM::PbiFilter& filter,
+                                                         const BAM::DataSet& dataset,
+                                                         const std::int32_t numThreads)
+{
+    static constexpr char BAMREADER_ENV[] = "PB_BAMREADER_THREADS";
+    std::optional<std::string> previous;
+    if (const char* value = std::getenv(BAMREADER_ENV)) {
+        previous = value;
+    }
+    const auto restore = [&previous]() {
+        if (previous) {
+            setenv(BAMREADER_ENV, previous->c_str(), true);
+        } else {
+            unsetenv(BAMREADER_ENV);
+        }
+    };
+
+    setenv(BAMREADER_ENV, std::to_string(numThreads).c_str(), true);
+    try {
+        auto query = std::make_unique<BAM::PbiFilterQuery>(filter, dataset);
+        restore();
+        return query;
+    } catch (...) {
+        restore();
+        throw;
+    }
+}
+
+// Create BAM readers for a given file path (might have filters) and configuration (might chunk)
 void CreateBamReader(const std::filesystem::path& filePath, const BamZmwReaderConfig& config,
-                     std::int32_t& numZmws, std::unique_ptr<BAM::internal::IQuery>& query,
-                     std::int32_t& endZmwHoleNumber)
+                     std::int32_t& numZmws,
+                     std::vector<std::unique_ptr<BAM::internal::IQuery>>& queries,
+                     std::int32_t& endZmwFileIdx, std::int32_t& endZmwHoleNumber)
 {
     const BAM::DataSet dataset{filePath};
     const BAM::PbiFilter filter = BAM::PbiFilter::FromDataSet(dataset);
 
     // Indicate that there should be no end ZMW stopping by default / last chunk
+    endZmwFileIdx = -1;
     endZmwHoleNumber = -1;
 
     // Local variable to ease access to the chunking parameters
@@ -189,7 +339,7 @@ void CreateBamReader(const std::filesystem::path& filePath, const BamZmwReaderCo
     // Is the last chunk requested?
     const bool lastChunk{(chunkNumerator == chunkDenominator) && (chunkDenominator > 0)};
     // Access to the first ZMW of the chunk
-    UniqueZmw startZmw{-1, -1, -1};
+    UniqueZmw startZmw{0, -1, -1, -1, -1, 0};
     // Is a specific chunk requested?
     if ((chunkNumerator > 0) && (chunkDenominator > 0)) {
         // Can we use ZMW chunking? Not with filters!
@@ -208,16 +358,34 @@ void CreateBamReader(const std::filesystem::path& filePath, const BamZmwReaderCo
                 "Fewer ZMWs available than specified chunks: " + std::to_string(numZmwsAll) +
                 " vs. " + std::to_string(chunkDenominator));
         }
-        // Calculate the number of ZMWs per chunk
-        const double chunkSize = 1.0 * numZmwsAll / chunkDenominator;
-        // Calculate the start ZMW of the chunk
-        const std::int32_t firstChunkIdx =
-            firstChunk ? 0 : std::round(chunkSize * (chunkNumerator - 1));
+        std::int32_t firstChunkIdx;
+        std::int32_t lastChunkIdx;
+        if (config.BalanceChunks) {
+            std::optional<ZmwOffsetIndexCache> localIndices;
+            if (!config.ZmwIndices) {
+                localIndices.emplace(config.PersistentZmwIndex);
+            }
+            const std::vector<std::int64_t> costs =
+                EstimateZmwCosts(dataset, zmwsUniq, config.SubreadFile,
+                                 config.ZmwIndices ? *config.ZmwIndices : *localIndices);
+            const std::vector<std::int32_t> starts = BalancedChunkStarts(costs, chunkDenominator);
+            firstChunkIdx = starts[chunkNumerator - 1];
+            lastChunkIdx = lastChunk ? numZmwsAll - 1 : starts[chunkNumerator];
+            const std::int64_t chunkCost =
+                std::accumulate(costs.cbegin() + firstChunkIdx,
+                                costs.cbegin() + starts[chunkNumerator], std::int64_t{0});
+            PBLOG_BLOCK_INFO("Chunk cost", std::to_string(chunkCost) + " bases");
+        } else {
+            // Calculate the number of ZMWs per chunk
+            const double chunkSize = 1.0 * numZmwsAll / chunkDenominator;
+            // Calculate the start ZMW of the chunk
+            firstChunkIdx = firstChunk ? 0 : std::round(chunkSize * (chunkNumerator - 1));
+            // Calculate the end ZMW of the chunk
+            lastChunkIdx =
+                lastChunk ? std::ssize(zmwsUniq) - 1 : std::round(chunkSize * (chunkNumerator));
+        }
         // Store the start ZMW
         startZmw = zmwsUniq[firstChunkIdx];
-        // Calculate the end ZMW of the chunk
-        const std::int32_t lastChunkIdx =
-            lastChunk ? std::ssize(zmwsUniq) - 1 : std::round(chunkSize * (chunkNumerator));
         // Update the number of ZMWs in the chunk
         numZmws = lastChunkIdx - firstChunkIdx + static_cast<std::int32_t>(lastChunk);
         PBLOG_BLOCK_INFO("Chunk index",
@@ -227,24 +395,33 @@ void CreateBamReader(const std::filesystem::path& filePath, const BamZmwReaderCo
                                           (lastChunk ? ']' : ')'));
         // Store the end ZMW, which is exclusive in the range
         if (!lastChunk) {
+            endZmwFileIdx = zmwsUniq[lastChunkIdx].FileIdx;
             endZmwHoleNumber = zmwsUniq[lastChunkIdx].HoleNumber;
         }
     }
 
     if (filter.IsEmpty()) {  // No filter used, we allow to chunk
-        // Do not allow more than ONE BAM file
-        if (std::ssize(dataset.BamFiles()) != 1) {
-            throw PB_CLI_ALARM("Input must have exactly one BAM file.");
+        // Create one BAM reader per BAM file, starting with the file of the first ZMW
+        const std::vector<BAM::BamFile> bamFiles = dataset.BamFiles();
+        if (bamFiles.empty()) {
+            throw PB_CLI_ALARM("Input has no BAM files.");
+        }
+        const std::int32_t lastFileIdx =
+            endZmwFileIdx == -1 ? std::ssize(bamFiles) - 1 : endZmwFileIdx;
+        for (std::int32_t fileIdx = startZmw.FileIdx; fileIdx <= lastFileIdx; ++fileIdx) {
+            queries.emplace_back(
+                std::make_unique<PooledBamReader>(bamFiles[fileIdx], config.ThreadPool));
         }
-        // Create a BAM reader for the first BAM file
-        query = std::make_unique<BAM::BamReader>(dataset.BamFiles().front());
-        auto& reader = dynamic_cast<BAM::BamReader&>(*query);
         if (startZmw.FileOffset != -1) {
             PBLOG_BLOCK_DEBUG("Chunking", "File offset " + std::to_string(startZmw.FileOffset));
-            reader.VirtualSeek(startZmw.FileOffset);
+            dynamic_cast<BAM::BamReader&>(*queries.front()).VirtualSeek(startZmw.FileOffset);
+        }
+        // The end ZMW index is relative to the first opened file
+        if (endZmwFileIdx != -1) {
+            endZmwFileIdx -= startZmw.FileIdx;
         }
     } else {  // Filter used, we do not allow to chunk
-        query = std::make_unique<BAM::PbiFilterQuery>(filter, dataset);
+        queries.emplace_back(CreateFilterQuery(filter, dataset, config.FilterQueryThreads));
     }
 }
 
@@ -253,19 +430,38 @@ void CreateBamReader(const std::filesystem::path& filePath, const BamZmwReaderCo
 BamZmwReader::BamZmwReader(std::filesystem::path path, BamZmwReaderConfig config)
     : path_{std::move(path)}, config_{std::move(config)}
 {
-    CreateBamReader(path_, config_, numZmws_, reader_, endZmwHoleNumber_);
+    CreateBamReader(path_, config_, numZmws_, readers_, endZmwFileIdx_, endZmwHoleNumber_);
 }
 
 bool BamZmwReader::GetNext(ZmwRecords& zmw)
+{
+    // Files are processed one after the other
+    while (curReader_ < std::ssize(readers_)) {
+        if (GetNextInFile(zmw)) {
+            return true;
+        }
+        if (endOfChunk_) {
+            return false;
+        }
+        ++curReader_;
+        lastRecord_ = std::nullopt;
+        endOfFile_ = false;
+    }
+    return false;
+}
+
+bool BamZmwReader::GetNextInFile(ZmwRecords& zmw)
 {
     if (endOfFile_) {
         return false;
     }
 
+    BAM::internal::IQuery& reader = *readers_[curReader_];
+
     // This is the first record of the BAM file
     if (!lastRecord_) {
         BAM::BamRecord record;
-        if (!reader_->GetNext(record)) {
+        if (!reader.GetNext(record)) {
             PBLOG_BLOCK_WARN("BamZmwReader", "Input BAM is empty");
             return false;
         }
@@ -277,7 +473,9 @@ bool BamZmwReader::GetNext(ZmwRecords& zmw)
 
     // Check if this is past the last ZMW of the chunk
     std::int32_t holeNumber = lastRecord_->HoleNumber();
-    if ((endZmwHoleNumber_ != -1) && (endZmwHoleNumber_ == holeNumber)) {
+    if ((endZmwHoleNumber_ != -1) && (endZmwFileIdx_ == curReader_) &&
+        (endZmwHoleNumber_ == holeNumber)) {
+        endOfChunk_ = true;
         return false;
     }
 
@@ -296,19 +494,21 @@ bool BamZmwReader::GetNext(ZmwRecords& zmw)
         }
     };
 
-    // Read next records until we have a full ZMW
-    for (const auto& read : *reader_) {
+    // Read next records until we have a full ZMW, records are moved, never copied
+    BAM::BamRecord read;
+    while (reader.GetNext(read)) {
         PBLOG_BLOCK_TRACE("BamZmwReader", "BamRecord reading " + read.FullName());
         // Check if we've started a new ZMW
         if (holeNumber != read.HoleNumber()) {
             // Stop adding records to this ZMW and change ownership
             changeOwnership();
             // Start a new ZMW with this record
-            lastRecord_ = read;
+            lastRecord_ = std::move(read);
             // Return true to indicate that we have a new ZMW
             return true;
         }
-        inputBamRecords.emplace_back(read);
+        inputBamRecords.emplace_back(std::move(read));
+        read = BAM::BamRecord{};
     }
 
     // If we have reached this, we have reached the end of the file
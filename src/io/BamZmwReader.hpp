@@ -12,6 +12,7 @@
 #include <filesystem>
 #include <memory>
 #include <optional>
+#include <vector>
 
 namespace PacBio {
 namespace IO {
@@ -23,13 +24,18 @@ public:
     bool GetNext(ZmwRecords& zmw) final;
 
 private:
+    bool GetNextInFile(ZmwRecords& zmw);
+
     std::filesystem::path path_;
     BamZmwReaderConfig config_;
-    std::unique_ptr<BAM::internal::IQuery> reader_;
+    std::vector<std::unique_ptr<BAM::internal::IQuery>> readers_;
+    std::int32_t curReader_{0};
     std::int32_t numZmws_;
+    std::int32_t endZmwFileIdx_;
     std::int32_t endZmwHoleNumber_;
     std::optional<BAM::BamRecord> lastRecord_;
     bool endOfFile_{false};
+    bool endOfChunk_{false};
 };
 
 }  // namespace IO
@@ -9,7 +9,6 @@
 
 namespace PacBio {
 namespace IO {
-namespace {
 
 // Determine start and end hole numbers for a given chunk
 std::pair<std::int32_t, std::int32_t> DetermineChunk(const std::string& chunk)
@@ -58,12 +57,12 @@ std::pair<std::int32_t, std::int32_t> DetermineChunk(const std::string& chunk)
     return std::make_pair(chunkNumerator, chunkDenominator);
 }
 
-}  // namespace
-
 BamZmwReaderConfig::BamZmwReaderConfig(const CLI_v2::Results& options)
 {
     // Parse chunk string
     std::tie(ChunkNumerator, ChunkDenominator) = DetermineChunk(options[OptionNames::Chunk]);
+    BalanceChunks = options[OptionNames::BalanceChunks];
+    PersistentZmwIndex = options[OptionNames::ZmwIndex];
 }
 
 }  // namespace IO
@@ -1,9 +1,14 @@
 #ifndef Actc_IO_BAMZMWREADERCONFIG_HPP
 #define Actc_IO_BAMZMWREADERCONFIG_HPP
 
+#include "BgzfThreadPool.hpp"
+#include "ZmwOffsetIndex.hpp"
+
 #include <pbcopper/cli2/Option.h>
 #include <pbcopper/cli2/Results.h>
 
+#include <string>
+#include <utility>
 #include <vector>
 
 #include <cstdint>
@@ -21,9 +26,28 @@ R"({
     "default" : ""
 })"
 };
+
+const CLI_v2::Option BalanceChunks{
+R"({
+    "names" : ["balance-chunks"],
+    "description" : "Cut --chunk boundaries at equal estimated alignment cost, based on subread and CCS bases, instead of equal ZMW counts.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option ZmwIndex{
+R"({
+    "names" : ["zmw-index"],
+    "description" : "Build a memory-mappable ZMW offset index next to each subread .pbi once and reuse it in later runs.",
+    "type" : "bool"
+})"
+};
 // clang-format on
 }  // namespace OptionNames
 
+// Chunk numerator and denominator of an i/N string, -1 for both if empty
+std::pair<std::int32_t, std::int32_t> DetermineChunk(const std::string& chunk);
+
 struct BamZmwReaderConfig
 {
     BamZmwReaderConfig(const CLI_v2::Results& options);
@@ -32,6 +56,18 @@ struct BamZmwReaderConfig
 
     std::int32_t ChunkNumerator{-1};
     std::int32_t ChunkDenominator{-1};
+    bool BalanceChunks{false};
+    // Subreads used to estimate the cost per ZMW for balanced chunks
+    std::string SubreadFile;
+    // Memory-map persistent ZMW offset indices of the subreads
+    bool PersistentZmwIndex{false};
+    // Shared pool decompressing the input BAM files, if set
+    const BgzfThreadPool* ThreadPool{nullptr};
+    // Decompression threads per BAM file of a filtered dataset query, whose
+    // readers are opened by pbbam and cannot share the pool
+    std::int32_t FilterQueryThreads{1};
+    // Shared ZMW offset indices of the subreads, if set
+    ZmwOffsetIndexCache* ZmwIndices{nullptr};
 };
 
 }  // namespace IO
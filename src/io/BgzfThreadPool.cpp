@@ -0,0 +1,34 @@
+#include "BgzfThreadPool.hpp"
+
+#include <pbcopper/utility/Alarm.h>
+
+#include <htslib/bgzf.h>
+
+#include <string>
+
+namespace PacBio {
+namespace IO {
+
+BgzfThreadPool::BgzfThreadPool(const std::int32_t numThreads) : pool_{hts_tpool_init(numThreads)}
+{
+    if (!pool_) {
+        throw PB_ALARM("ThreadPoolError", "Could not create BGZF thread pool with " +
+                                              std::to_string(numThreads) + " threads");
+    }
+}
+
+BgzfThreadPool::~BgzfThreadPool() { hts_tpool_destroy(pool_); }
+
+hts_tpool* BgzfThreadPool::Get() const { return pool_; }
+
+PooledBamReader::PooledBamReader(const BAM::BamFile& bamFile, const BgzfThreadPool* pool)
+    : BAM::BamReader{bamFile}
+{
+    if (pool && bgzf_thread_pool(Bgzf(), pool->Get(), 0) != 0) {
+        throw PB_ALARM("ThreadPoolError",
+                       "Could not attach BGZF thread pool to " + bamFile.Filename());
+    }
+}
+
+}  // namespace IO
+}  // namespace PacBio
@@ -0,0 +1,41 @@
+#ifndef Actc_IO_BGZFTHREADPOOL_HPP
+#define Actc_IO_BGZFTHREADPOOL_HPP
+
+#include <htslib/thread_pool.h>
+#include <pbbam/BamFile.h>
+#include <pbbam/BamReader.h>
+
+#include <cstdint>
+
+namespace PacBio {
+namespace IO {
+
+// One htslib thread pool shared by all BGZF streams of a run, so that
+// (de)compression capacity goes to whichever stream needs it
+class BgzfThreadPool
+{
+public:
+    explicit BgzfThreadPool(std::int32_t numThreads);
+    ~BgzfThreadPool();
+
+    BgzfThreadPool(const BgzfThreadPool&) = delete;
+    BgzfThreadPool& operator=(const BgzfThreadPool&) = delete;
+
+    hts_tpool* Get() const;
+
+private:
+    hts_tpool* pool_;
+};
+
+// BamReader whose BGZF stream is decompressed by a shared thread pool
+class PooledBamReader : public BAM::BamReader
+{
+public:
+    // Without a pool, the stream is decompressed single-threaded
+    PooledBamReader(const BAM::BamFile& bamFile, const BgzfThreadPool* pool);
+};
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_BGZFTHREADPOOL_HPP
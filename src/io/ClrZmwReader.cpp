@@ -0,0 +1,103 @@
+#include "ClrZmwReader.hpp"
+
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+
+#include <string>
+#include <utility>
+
+namespace PacBio {
+namespace IO {
+
+ClrZmwReader::ClrZmwReader(const std::vector<BAM::BamFile>& bamFiles, ZmwOffsetIndexCache& indices,
+                           RecordPool& pool, const BgzfThreadPool* threadPool)
+    : pool_{pool}
+{
+    for (const BAM::BamFile& bamFile : bamFiles) {
+        if (!bamFile.PacBioIndexExists()) {
+            throw PB_CLI_ALARM("Missing PBI file for " + bamFile.Filename() +
+                               ". Please generate one with : pbindex " + bamFile.Filename() +
+                               " You can get pbindex from bioconda: conda install -c bioconda "
+                               "pbbam");
+        }
+
+        const auto readGroups = bamFile.Header().ReadGroups();
+        if (readGroups.empty()) {
+            throw PB_CLI_ALARM("Missing read groups in " + bamFile.Filename());
+        }
+        const std::string movieName = readGroups.front().MovieName();
+        for (const auto& rg : readGroups) {
+            if (rg.MovieName() != movieName) {
+                throw PB_CLI_ALARM("Subread BAM files must hold a single movie: " +
+                                   bamFile.Filename());
+            }
+        }
+
+        // First record per ZMW
+        const std::string pbiFile = bamFile.PacBioIndexFilename();
+        File file{movieName, indices.Get(pbiFile),
+                  std::make_unique<PooledBamReader>(bamFile, threadPool), BAM::BamRecord{}, false};
+        PBLOG_BLOCK_DEBUG("CLR reader", bamFile.Filename() + " with " +
+                                            std::to_string(file.Index->Entries().size()) + " ZMWs");
+
+        file.HasNextRecord = file.Reader->GetNext(file.NextRecord);
+
+        if (files_.empty()) {
+            header_ = bamFile.Header().DeepCopy();
+        } else {
+            header_ += bamFile.Header();
+        }
+        files_.emplace_back(std::move(file));
+    }
+}
+
+const BAM::BamHeader& ClrZmwReader::Header() const { return header_; }
+
+bool ClrZmwReader::GetZmw(const std::string& movieName, const std::int32_t holeNumber,
+                          std::vector<BAM::BamRecord>& records)
+{
+    for (File& file : files_) {
+        // A single file is matched by hole number only
+        if (files_.size() > 1 && file.MovieName != movieName) {
+            continue;
+        }
+        const ZmwOffsetIndex::Entry* entry = file.Index->Find(holeNumber);
+        if (!entry) {
+            continue;
+        }
+
+        // Sorted input is streamed, only seek for gaps
+        if (!file.HasNextRecord || file.NextRecord.HoleNumber() != holeNumber) {
+            PBLOG_BLOCK_DEBUG("CLR parser", "SEEKING");
+            file.Reader->VirtualSeek(entry->FileOffset);
+            file.HasNextRecord = file.Reader->GetNext(file.NextRecord);
+        }
+        records.reserve(records.size() + entry->NumRecords);
+        while (file.HasNextRecord && file.NextRecord.HoleNumber() == holeNumber) {
+            PBLOG_BLOCK_DEBUG("CLR parser", file.NextRecord.FullName());
+            records.emplace_back(std::move(file.NextRecord));
+            file.NextRecord = pool_.Acquire();
+            file.HasNextRecord = file.Reader->GetNext(file.NextRecord);
+        }
+        return true;
+    }
+    return false;
+}
+
+std::optional<ClrZmwReader::ZmwLocation> ClrZmwReader::Locate(const std::string& movieName,
+                                                              const std::int32_t holeNumber) const
+{
+    for (std::int32_t fileIdx = 0; fileIdx < std::ssize(files_); ++fileIdx) {
+        const File& file = files_[fileIdx];
+        if (files_.size() > 1 && file.MovieName != movieName) {
+            continue;
+        }
+        if (const ZmwOffsetIndex::Entry* entry = file.Index->Find(holeNumber)) {
+            return ZmwLocation{fileIdx, entry->FileOffset};
+        }
+    }
+    return std::nullopt;
+}
+
+}  // namespace IO
+}  // namespace PacBio
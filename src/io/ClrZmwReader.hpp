@@ -0,0 +1,70 @@
+#ifndef Actc_IO_CLRZMWREADER_HPP
+#define Actc_IO_CLRZMWREADER_HPP
+
+#include "BgzfThreadPool.hpp"
+#include "RecordPool.hpp"
+#include "ZmwOffsetIndex.hpp"
+
+#include <pbbam/BamFile.h>
+#include <pbbam/BamHeader.h>
+#include <pbbam/BamReader.h>
+#include <pbbam/BamRecord.h>
+
+#include <cstdint>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace PacBio {
+namespace IO {
+
+// Random access to the ZMWs of one or more subread BAM files, each with its
+// own reader and PBI. Every file must hold a single movie, ZMWs are looked up
+// by movie name and hole number. ZMW offsets come from the index cache, which
+// memory-maps a sidecar of each PBI for persistent indices.
+// Records are read into buffers taken from the pool and moved out, never copied.
+class ClrZmwReader
+{
+public:
+    // Where the records of a ZMW start, ZMWs are read fastest in this order
+    struct ZmwLocation
+    {
+        std::int32_t FileIdx;
+        std::int64_t FileOffset;
+    };
+
+    // Without a thread pool, each file is decompressed single-threaded
+    ClrZmwReader(const std::vector<BAM::BamFile>& bamFiles, ZmwOffsetIndexCache& indices,
+                 RecordPool& pool, const BgzfThreadPool* threadPool);
+
+    // Merged header of all files
+    const BAM::BamHeader& Header() const;
+
+    // Reads all records of a ZMW, returns false if no file holds the ZMW
+    bool GetZmw(const std::string& movieName, std::int32_t holeNumber,
+                std::vector<BAM::BamRecord>& records);
+
+    // Returns nothing if no file holds the ZMW
+    std::optional<ZmwLocation> Locate(const std::string& movieName, std::int32_t holeNumber) const;
+
+private:
+    struct File
+    {
+        std::string MovieName;
+        std::shared_ptr<const ZmwOffsetIndex> Index;
+        std::unique_ptr<BAM::BamReader> Reader;
+        BAM::BamRecord NextRecord;
+        bool HasNextRecord{false};
+    };
+
+    RecordPool& pool_;
+    BAM::BamHeader header_;
+    std::vector<File> files_;
+};
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_CLRZMWREADER_HPP
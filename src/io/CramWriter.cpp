@@ -0,0 +1,148 @@
+#include "CramWriter.hpp"
+
+#include <pbcopper/logging/Logging.h>
+#include <pbcopper/utility/Alarm.h>
+
+#include <htslib/faidx.h>
+#include <htslib/hts.h>
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <utility>
+
+namespace PacBio {
+namespace IO {
+namespace {
+
+// 8-bit kinetics arrays of subreads and by-strand CCS reads
+constexpr std::array<const char*, 6> KINETICS_TAGS{"ip", "pw", "fi", "ri", "fp", "rp"};
+
+// Keeps the upper five bits of each codec V1 value, which lowers the entropy
+// of the arrays while staying within the same frame scale
+void QuantizeKinetics(bam1_t* record)
+{
+    for (const char* tag : KINETICS_TAGS) {
+        uint8_t* data = bam_aux_get(record, tag);
+        if (!data || data[0] != 'B' || data[1] != 'C') {
+            continue;
+        }
+        uint32_t length;
+        std::memcpy(&length, data + 2, sizeof(length));
+        uint8_t* values = data + 2 + sizeof(length);
+        for (uint32_t i = 0; i < length; ++i) {
+            values[i] = (values[i] & 0xF8) | 0x04;
+        }
+    }
+}
+
+}  // namespace
+
+CramWriter::CramWriter(const std::string& filename, const BAM::BamHeader& header,
+                       const std::string& referenceFasta, const BgzfThreadPool* threadPool,
+                       const bool lossyKinetics, const bool index)
+    : filename_{filename}, lossyKinetics_{lossyKinetics}, index_{index}
+{
+    // The FASTA is rewritten by every run, an existing .fai might be stale
+    if (fai_build(referenceFasta.c_str()) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not index CRAM reference " + referenceFasta);
+    }
+
+    file_ = sam_open(filename.c_str(), "wc");
+    if (!file_) {
+        throw PB_ALARM("OutputDataError", "Could not open CRAM output " + filename);
+    }
+    if (hts_set_fai_filename(file_, referenceFasta.c_str()) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not set CRAM reference " + referenceFasta);
+    }
+    if (threadPool) {
+        htsThreadPool pool{threadPool->Get(), 0};
+        if (hts_set_thread_pool(file_, &pool) != 0) {
+            throw PB_ALARM("OutputDataError", "Could not set thread pool of " + filename);
+        }
+    }
+
+    const std::string text = header.ToSam();
+    header_ = sam_hdr_parse(text.size(), text.c_str());
+    if (!header_) {
+        throw PB_ALARM("OutputDataError", "Could not convert header for " + filename);
+    }
+#if !defined(HTS_VERSION) || HTS_VERSION < 101000
+    // Before htslib 1.10, only @SQ lines are parsed and the text is not kept
+    header_->l_text = text.size();
+    header_->text = static_cast<char*>(std::calloc(text.size() + 1, 1));
+    std::memcpy(header_->text, text.c_str(), text.size());
+#endif
+    if (sam_hdr_write(file_, header_) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not write header to " + filename);
+    }
+#if defined(HTS_VERSION) && HTS_VERSION >= 101000
+    if (index_ && sam_idx_init(file_, header_, 0, (filename + ".crai").c_str()) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not start index of " + filename);
+    }
+#endif
+    scratch_ = bam_init1();
+}
+
+CramWriter::~CramWriter()
+{
+    try {
+        Close();
+    } catch (const std::exception& e) {
+        PBLOG_ERROR << e.what();
+    }
+    if (header_) {
+        bam_hdr_destroy(header_);
+    }
+    if (scratch_) {
+        bam_destroy1(scratch_);
+    }
+}
+
+void CramWriter::Close()
+{
+    if (!file_) {
+        return;
+    }
+    samFile* const file = std::exchange(file_, nullptr);
+#if defined(HTS_VERSION) && HTS_VERSION >= 101000
+    const bool indexSaved = !index_ || sam_idx_save(file) == 0;
+    if (sam_close(file) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not finish CRAM output " + filename_);
+    }
+    if (!indexSaved) {
+        throw PB_ALARM("OutputDataError", "Could not write index of " + filename_);
+    }
+#else
+    if (sam_close(file) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not finish CRAM output " + filename_);
+    }
+    // Before htslib 1.10, the index can only be built from the closed file
+    if (index_ && sam_index_build(filename_.c_str(), 0) != 0) {
+        throw PB_ALARM("OutputDataError", "Could not write index of " + filename_);
+    }
+#endif
+}
+
+void CramWriter::TryFlush() { hts_flush(file_); }
+
+void CramWriter::Write(const BAM::BamRecord& record) { Write(record.Impl()); }
+
+void CramWriter::Write(const BAM::BamRecordImpl& recordImpl)
+{
+    const auto& raw = recordImpl.RawData();
+    const bam1_t* record = &*raw;
+    if (lossyKinetics_) {
+        bam_copy1(scratch_, record);
+        QuantizeKinetics(scratch_);
+        record = scratch_;
+    }
+    if (sam_write1(file_, header_, record) < 0) {
+        throw PB_ALARM("OutputDataError", "Could not write record to " + filename_);
+    }
+}
+
+}  // namespace IO
+}  // namespace PacBio
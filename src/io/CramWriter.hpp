@@ -0,0 +1,54 @@
+#ifndef Actc_IO_CRAMWRITER_HPP
+#define Actc_IO_CRAMWRITER_HPP
+
+#include "BgzfThreadPool.hpp"
+
+#include <htslib/sam.h>
+#include <pbbam/BamHeader.h>
+#include <pbbam/BamRecord.h>
+#include <pbbam/BamRecordImpl.h>
+#include <pbbam/IRecordWriter.h>
+
+#include <string>
+
+namespace PacBio {
+namespace IO {
+
+// Writes aligned records as CRAM, encoding sequences against the reference
+// FASTA. All aux tags, including PacBio tags, are stored.
+class CramWriter : public BAM::IRecordWriter
+{
+public:
+    // The reference FASTA is (re)indexed. With lossy kinetics,
+    // the lowest three bits of each 8-bit kinetics value are dropped. With
+    // index, records must be coordinate-sorted and OUT.cram.crai is built
+    // while writing.
+    CramWriter(const std::string& filename, const BAM::BamHeader& header,
+               const std::string& referenceFasta, const BgzfThreadPool* threadPool,
+               bool lossyKinetics, bool index = false);
+    // Closes without throwing, failures are only logged
+    ~CramWriter() override;
+
+    CramWriter(const CramWriter&) = delete;
+    CramWriter& operator=(const CramWriter&) = delete;
+
+    // Flushes the output and writes the index, throws on failure
+    void Close();
+
+    void TryFlush() override;
+    void Write(const BAM::BamRecord& record) override;
+    void Write(const BAM::BamRecordImpl& recordImpl) override;
+
+private:
+    std::string filename_;
+    samFile* file_{nullptr};
+    bam_hdr_t* header_{nullptr};
+    bam1_t* scratch_{nullptr};
+    bool lossyKinetics_;
+    bool index_;
+};
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_CRAMWRITER_HPP
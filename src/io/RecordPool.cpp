@@ -0,0 +1,42 @@
+#include "RecordPool.hpp"
+
+#include <utility>
+
+namespace PacBio {
+namespace IO {
+
+RecordPool::RecordPool(const std::size_t capacity) : capacity_{capacity}
+{
+    records_.reserve(capacity_);
+}
+
+BAM::BamRecord RecordPool::Acquire()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (!records_.empty()) {
+            BAM::BamRecord record{std::move(records_.back())};
+            records_.pop_back();
+            return record;
+        }
+    }
+    return BAM::BamRecord{};
+}
+
+void RecordPool::Release(std::vector<BAM::BamRecord>& records)
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        for (auto& record : records) {
+            if (records_.size() == capacity_) {
+                break;
+            }
+            records_.emplace_back(std::move(record));
+        }
+    }
+    // Surplus records are freed outside of the lock
+    records.clear();
+}
+
+}  // namespace IO
+}  // namespace PacBio
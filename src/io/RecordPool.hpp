@@ -0,0 +1,37 @@
+#ifndef Actc_IO_RECORDPOOL_HPP
+#define Actc_IO_RECORDPOOL_HPP
+
+#include <pbbam/BamRecord.h>
+
+#include <cstddef>
+
+#include <mutex>
+#include <vector>
+
+namespace PacBio {
+namespace IO {
+
+// Thread-safe free list of BAM records. Reading into a recycled record reuses
+// its bam1_t data buffer, which avoids one malloc/free pair per record.
+class RecordPool
+{
+public:
+    // At most capacity records are kept, surplus records are freed
+    explicit RecordPool(std::size_t capacity);
+
+    // Returns a recycled record, or a new one if the pool is empty
+    BAM::BamRecord Acquire();
+
+    // Takes ownership of all records and clears the vector
+    void Release(std::vector<BAM::BamRecord>& records);
+
+private:
+    const std::size_t capacity_;
+    std::mutex mutex_;
+    std::vector<BAM::BamRecord> records_;
+};
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_RECORDPOOL_HPP
@@ -0,0 +1,252 @@
+#include "ZmwOffsetIndex.hpp"
+
+#include <pbbam/PbiRawData.h>
+#include <pbcopper/logging/Logging.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+
+namespace PacBio {
+namespace IO {
+namespace {
+
+constexpr char SIDECAR_MAGIC[8] = {'A', 'C', 'T', 'C', 'Z', 'M', 'I', '\0'};
+constexpr std::uint32_t SIDECAR_VERSION = 1;
+
+// Fixed-size header, followed by NumEntries entries
+struct SidecarHeader
+{
+    char Magic[8];
+    std::uint32_t Version;
+    std::uint32_t EntrySize;
+    // Size and modification time of the PBI the sidecar was built from
+    std::uint64_t PbiSize;
+    std::int64_t PbiMtime;
+    std::uint64_t NumEntries;
+};
+
+static_assert(sizeof(SidecarHeader) % alignof(ZmwOffsetIndex::Entry) == 0);
+
+std::int64_t ModificationTime(const std::string& filename)
+{
+    return std::filesystem::last_write_time(filename).time_since_epoch().count();
+}
+
+}  // namespace
+
+std::string ZmwOffsetIndex::Filename(const std::string& pbiFile) { return pbiFile + ".zmi"; }
+
+ZmwOffsetIndex ZmwOffsetIndex::FromPbi(const std::string& pbiFile)
+{
+    const BAM::PbiRawData pbi{pbiFile};
+    const BAM::PbiRawBasicData& basic = pbi.BasicData();
+    const std::int32_t numRecords = std::ssize(basic.holeNumber_);
+
+    ZmwOffsetIndex index;
+    for (std::int32_t i = 0; i < numRecords; ++i) {
+        if (i == 0 || basic.holeNumber_[i] != basic.holeNumber_[i - 1]) {
+            index.entries_.emplace_back(Entry{basic.holeNumber_[i], 0, basic.fileOffset_[i], 0});
+        }
+        Entry& entry = index.entries_.back();
+        ++entry.NumRecords;
+        entry.Bases += std::max(0, basic.qEnd_[i] - basic.qStart_[i]);
+    }
+
+    // Keep the first occurrence of each ZMW, the input is sorted by ZMW
+    std::stable_sort(
+        index.entries_.begin(), index.entries_.end(),
+        [](const Entry& lhs, const Entry& rhs) { return lhs.HoleNumber < rhs.HoleNumber; });
+    const auto last = std::unique(
+        index.entries_.begin(), index.entries_.end(),
+        [](const Entry& lhs, const Entry& rhs) { return lhs.HoleNumber == rhs.HoleNumber; });
+    index.entries_.erase(last, index.entries_.end());
+
+    index.view_ = index.entries_;
+    return index;
+}
+
+ZmwOffsetIndex ZmwOffsetIndex::Persistent(const std::string& pbiFile)
+{
+    const std::string filename = Filename(pbiFile);
+    const std::uint64_t pbiSize = std::filesystem::file_size(pbiFile);
+    const std::int64_t pbiMtime = ModificationTime(pbiFile);
+
+    ZmwOffsetIndex mapped;
+    if (mapped.Map(filename, pbiSize, pbiMtime)) {
+        PBLOG_BLOCK_DEBUG("ZMW index", "Mapped " + filename);
+        return mapped;
+    }
+
+    ZmwOffsetIndex index = FromPbi(pbiFile);
+
+    // Concurrent processes may build the same sidecar, each writes its own
+    // temporary file and the rename is atomic
+    const std::string tmpFilename = filename + ".tmp." + std::to_string(::getpid());
+    {
+        SidecarHeader header{};
+        std::memcpy(header.Magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+        header.Version = SIDECAR_VERSION;
+        header.EntrySize = sizeof(Entry);
+        header.PbiSize = pbiSize;
+        header.PbiMtime = pbiMtime;
+        header.NumEntries = index.entries_.size();
+
+        std::ofstream out{tmpFilename, std::ios::binary};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(index.entries_.data()),
+                  index.entries_.size() * sizeof(Entry));
+        out.flush();
+        if (!out) {
+            PBLOG_BLOCK_WARN("ZMW index", "Could not write " + filename + ", keeping it in memory");
+            std::error_code ec;
+            std::filesystem::remove(tmpFilename, ec);
+            return index;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpFilename, filename, ec);
+    if (ec) {
+        PBLOG_BLOCK_WARN("ZMW index", "Could not write " + filename + ", keeping it in memory");
+        std::filesystem::remove(tmpFilename, ec);
+        return index;
+    }
+    PBLOG_BLOCK_INFO("ZMW index", "Wrote " + filename);
+
+    if (mapped.Map(filename, pbiSize, pbiMtime)) {
+        return mapped;
+    }
+    return index;
+}
+
+ZmwOffsetIndex::ZmwOffsetIndex(ZmwOffsetIndex&& other) noexcept
+    : entries_{std::move(other.entries_)}
+    , mapping_{std::exchange(other.mapping_, nullptr)}
+    , mappingSize_{std::exchange(other.mappingSize_, 0)}
+    , view_{std::exchange(other.view_, {})}
+{
+    if (!mapping_) {
+        view_ = entries_;
+    }
+}
+
+ZmwOffsetIndex& ZmwOffsetIndex::operator=(ZmwOffsetIndex&& other) noexcept
+{
+    if (this != &other) {
+        Unmap();
+        entries_ = std::move(other.entries_);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+        mappingSize_ = std::exchange(other.mappingSize_, 0);
+        view_ = std::exchange(other.view_, {});
+        if (!mapping_) {
+            view_ = entries_;
+        }
+    }
+    return *this;
+}
+
+ZmwOffsetIndex::~ZmwOffsetIndex() { Unmap(); }
+
+const ZmwOffsetIndex::Entry* ZmwOffsetIndex::Find(const std::int32_t holeNumber) const
+{
+    const auto it = std::lower_bound(
+        view_.begin(), view_.end(), holeNumber,
+        [](const Entry& entry, const std::int32_t value) { return entry.HoleNumber < value; });
+    if (it == view_.end() || it->HoleNumber != holeNumber) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+std::span<const ZmwOffsetIndex::Entry> ZmwOffsetIndex::Entries() const { return view_; }
+
+bool ZmwOffsetIndex::Map(const std::string& filename, const std::uint64_t pbiSize,
+                         const std::int64_t pbiMtime)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(SidecarHeader)) {
+        ::close(fd);
+        return false;
+    }
+    const std::size_t size = st.st_size;
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    // Outdated or foreign sidecars are rebuilt
+    const auto* header = static_cast<const SidecarHeader*>(mapping);
+    const bool valid = std::memcmp(header->Magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) == 0 &&
+                       header->Version == SIDECAR_VERSION && header->EntrySize == sizeof(Entry) &&
+                       header->PbiSize == pbiSize && header->PbiMtime == pbiMtime &&
+                       size == sizeof(SidecarHeader) + header->NumEntries * sizeof(Entry);
+    if (!valid) {
+        PBLOG_BLOCK_DEBUG("ZMW index", "Outdated " + filename);
+        ::munmap(mapping, size);
+        return false;
+    }
+
+    Unmap();
+    mapping_ = mapping;
+    mappingSize_ = size;
+    view_ = {
+        reinterpret_cast<const Entry*>(static_cast<const char*>(mapping) + sizeof(SidecarHeader)),
+        header->NumEntries};
+    return true;
+}
+
+void ZmwOffsetIndex::Unmap()
+{
+    if (mapping_) {
+        ::munmap(mapping_, mappingSize_);
+        mapping_ = nullptr;
+        mappingSize_ = 0;
+        view_ = {};
+    }
+}
+
+ZmwOffsetIndexCache::ZmwOffsetIndexCache(const bool persistent, const std::size_t capacity)
+    : persistent_{persistent}, capacity_{std::max<std::size_t>(1, capacity)}
+{
+}
+
+std::shared_ptr<const ZmwOffsetIndex> ZmwOffsetIndexCache::Get(const std::string& pbiFile)
+{
+    const std::uint64_t pbiSize = std::filesystem::file_size(pbiFile);
+    const std::int64_t pbiMtime = ModificationTime(pbiFile);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    ++numUses_;
+    const auto it = entries_.find(pbiFile);
+    if (it != entries_.end() && it->second.PbiSize == pbiSize && it->second.PbiMtime == pbiMtime) {
+        it->second.LastUse = numUses_;
+        return it->second.Index;
+    }
+
+    if (it == entries_.end() && entries_.size() >= capacity_) {
+        const auto oldest = std::min_element(entries_.cbegin(), entries_.cend(),
+                                             [](const auto& lhs, const auto& rhs) {
+                                                 return lhs.second.LastUse < rhs.second.LastUse;
+                                             });
+        entries_.erase(oldest);
+    }
+    auto index = std::make_shared<const ZmwOffsetIndex>(
+        persistent_ ? ZmwOffsetIndex::Persistent(pbiFile) : ZmwOffsetIndex::FromPbi(pbiFile));
+    entries_[pbiFile] = Cached{pbiSize, pbiMtime, numUses_, index};
+    return index;
+}
+
+}  // namespace IO
+}  // namespace PacBio
@@ -0,0 +1,101 @@
+#ifndef Actc_IO_ZMWOFFSETINDEX_HPP
+#define Actc_IO_ZMWOFFSETINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PacBio {
+namespace IO {
+
+// Per-ZMW summary of a BAM file, derived from its PBI. Entries are sorted by
+// hole number and looked up via binary search.
+//
+// The persistent variant stores the entries uncompressed in a sidecar next to
+// the PBI, which later processes memory-map read-only. Concurrent processes,
+// e.g. one per chunk, then share one page cache copy instead of each parsing
+// the full PBI.
+class ZmwOffsetIndex
+{
+public:
+    struct Entry
+    {
+        std::int32_t HoleNumber;
+        std::int32_t NumRecords;
+        // Virtual file offset of the first record
+        std::int64_t FileOffset;
+        // Summed query lengths of all records
+        std::int64_t Bases;
+    };
+
+    // Sidecar file of a PBI
+    static std::string Filename(const std::string& pbiFile);
+
+    // Builds the index in memory from the PBI
+    static ZmwOffsetIndex FromPbi(const std::string& pbiFile);
+
+    // Maps the sidecar of the PBI. A missing or outdated sidecar is rebuilt
+    // and written first, if that fails the index is kept in memory.
+    static ZmwOffsetIndex Persistent(const std::string& pbiFile);
+
+    ZmwOffsetIndex(ZmwOffsetIndex&& other) noexcept;
+    ZmwOffsetIndex& operator=(ZmwOffsetIndex&& other) noexcept;
+    ZmwOffsetIndex(const ZmwOffsetIndex&) = delete;
+    ZmwOffsetIndex& operator=(const ZmwOffsetIndex&) = delete;
+    ~ZmwOffsetIndex();
+
+    // Returns nullptr if the ZMW is not in the index
+    const Entry* Find(std::int32_t holeNumber) const;
+
+    std::span<const Entry> Entries() const;
+
+private:
+    ZmwOffsetIndex() = default;
+
+    bool Map(const std::string& filename, std::uint64_t pbiSize, std::int64_t pbiMtime);
+    void Unmap();
+
+    std::vector<Entry> entries_;
+    void* mapping_{nullptr};
+    std::size_t mappingSize_{0};
+    std::span<const Entry> view_;
+};
+
+// Indices of recently used PBIs, shared by all readers of a process. Entries
+// are rebuilt when their PBI changed, the least recently used entry is dropped
+// when the cache is full.
+class ZmwOffsetIndexCache
+{
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 64;
+
+    explicit ZmwOffsetIndexCache(bool persistent, std::size_t capacity = DEFAULT_CAPACITY);
+
+    std::shared_ptr<const ZmwOffsetIndex> Get(const std::string& pbiFile);
+
+private:
+    struct Cached
+    {
+        std::uint64_t PbiSize;
+        std::int64_t PbiMtime;
+        std::uint64_t LastUse;
+        std::shared_ptr<const ZmwOffsetIndex> Index;
+    };
+
+    const bool persistent_;
+    const std::size_t capacity_;
+    std::mutex mutex_;
+    std::uint64_t numUses_{0};
+    std::unordered_map<std::string, Cached> entries_;
+};
+
+}  // namespace IO
+}  // namespace PacBio
+
+#endif  // Actc_IO_ZMWOFFSETINDEX_HPP
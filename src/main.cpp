@@ -1,8 +1,19 @@
 #include "AlignmentResult.hpp"
+#include "Checkpoint.hpp"
 #include "LibraryInfo.hpp"
 #include "PancakeAligner.hpp"
+#include "ReorderBuffer.hpp"
+#include "Server.hpp"
+#include "ThreadBudget.hpp"
+#include "Trace.hpp"
+#include "ZmwAligner.hpp"
+#include "io/BamIndex.hpp"
 #include "io/BamZmwReader.hpp"
 #include "io/BamZmwReaderConfig.hpp"
+#include "io/BgzfThreadPool.hpp"
+#include "io/ClrZmwReader.hpp"
+#include "io/CramWriter.hpp"
+#include "io/RecordPool.hpp"
 #include "io/ZmwRecords.hpp"
 
 #include <htslib/hts.h>
@@ -11,13 +22,16 @@
 #include <pbbam/DataSet.h>
 #include <pbbam/EntireFileQuery.h>
 #include <pbbam/FastaWriter.h>
+#include <pbbam/IRecordWriter.h>
+#include <pbbam/IndexedBamWriter.h>
 #include <pbbam/PbbamVersion.h>
+#include <pbbam/PbiBuilder.h>
 #include <pbbam/PbiFilterQuery.h>
-#include <pbbam/PbiRawData.h>
 #include <pbcopper/cli2/CLI.h>
 #include <pbcopper/cli2/internal/BuiltinOptions.h>
 #include <pbcopper/logging/Logging.h>
 #include <pbcopper/parallel/WorkQueue.h>
+#include <pbcopper/utility/Alarm.h>
 #include <pbcopper/utility/MemoryConsumption.h>
 #include <pbcopper/utility/PbcopperVersion.h>
 #include <pbcopper/utility/Ssize.h>
@@ -27,15 +41,24 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/version.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <future>
 #include <iomanip>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <thread>
-#include <unordered_map>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 namespace PacBio {
 namespace OptionNames {
@@ -64,19 +87,258 @@ R"({
     "default" : 100
 })"
 };
+const CLI_v2::Option AutoBandwidth {
+R"({
+    "names" : ["auto-bandwidth"],
+    "description" : "Derive the alignment bandwidth per ZMW from CCS and subread lengths",
+    "type" : "bool"
+})"
+};
+const CLI_v2::Option PredictStrand {
+R"({
+    "names" : ["predict-strand"],
+    "description" : "Predict subread strands from pass alternation and map only that orientation",
+    "type" : "bool"
+})"
+};
+const CLI_v2::Option CheckpointInterval {
+R"({
+    "names" : ["checkpoint-interval"],
+    "description" : "Save a checkpoint every N written ZMWs, 0 disables checkpoints",
+    "type" : "int",
+    "default" : 0
+})"
+};
+const CLI_v2::Option Resume {
+R"({
+    "names" : ["resume"],
+    "description" : "Resume from the checkpoint of an interrupted run with identical options",
+    "type" : "bool"
+})"
+};
+const CLI_v2::Option StopAfterCheckpoint {
+R"({
+    "names" : ["stop-after-checkpoint"],
+    "description" : "Fail once the checkpoint of N written ZMWs is saved, as an interrupted run, to test --resume",
+    "type" : "int",
+    "default" : 0,
+    "hidden" : true
+})"
+};
+const CLI_v2::Option DecompressionThreads{
+R"({
+    "names" : ["decompression-threads"],
+    "description" : "Threads for BAM decompression of the inputs. 0 derives it from -j.",
+    "type" : "int",
+    "default" : 0
+})"
+};
+
+const CLI_v2::Option AlignmentThreads{
+R"({
+    "names" : ["alignment-threads"],
+    "description" : "Threads for alignment. 0 uses the share of -j not taken by the other stages.",
+    "type" : "int",
+    "default" : 0
+})"
+};
+
+const CLI_v2::Option CompressionThreads{
+R"({
+    "names" : ["compression-threads"],
+    "description" : "Threads for BAM compression of the output. 0 derives it from -j.",
+    "type" : "int",
+    "default" : 0
+})"
+};
+
+const CLI_v2::Option PinThreads{
+R"({
+    "names" : ["pin-threads"],
+    "description" : "Pin each alignment thread to its own CPU, filling one NUMA node after the other.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option LossyKinetics{
+R"({
+    "names" : ["lossy-kinetics"],
+    "description" : "For CRAM output, drop the lowest three bits of each kinetics value to improve compression.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option KeepTags{
+R"({
+    "names" : ["keep-tags"],
+    "description" : "Comma-separated aux tags copied from the input reads, all others are omitted. Example: np,rq,zm",
+    "type" : "string",
+    "default" : ""
+})"
+};
+
+const CLI_v2::Option DropTags{
+R"({
+    "names" : ["drop-tags"],
+    "description" : "Comma-separated aux tags omitted from the output records. Example: sn,cx",
+    "type" : "string",
+    "default" : ""
+})"
+};
+
+const CLI_v2::Option StripKinetics{
+R"({
+    "names" : ["strip-kinetics"],
+    "description" : "Omit kinetics tags ip, pw, fi, ri, fp, rp, fn and rn from the output records.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option PrimaryOnly{
+R"({
+    "names" : ["primary-only"],
+    "description" : "Only generate primary alignments, secondary and supplementary chains are dropped before alignment.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option Serve{
+R"({
+    "names" : ["serve"],
+    "description" : "Run as a daemon that accepts jobs on this Unix socket, inputs and output are then given per job.",
+    "type" : "string",
+    "default" : ""
+})"
+};
+
+const CLI_v2::Option Zmws{
+R"({
+    "names" : ["zmws"],
+    "description" : "Only align ZMWs in the inclusive hole number range FIRST-LAST.",
+    "type" : "string",
+    "default" : ""
+})"
+};
+
+const CLI_v2::Option ZmwStats{
+R"({
+    "names" : ["zmw-stats"],
+    "description" : "Write one line per ZMW with CCS length, subreads aligned, bases aligned, mean identity and alignment time to OUT.zmw_stats.tsv.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option MaxZmwTime{
+R"({
+    "names" : ["max-zmw-time"],
+    "description" : "Seconds to map and align one ZMW. ZMWs over budget are realigned with a narrow band and primary chains only, if that is over budget too their remaining subreads are left unaligned. 0 means no limit.",
+    "type" : "float",
+    "default" : 0
+})"
+};
+
+const CLI_v2::Option SubreadOrder{
+R"({
+    "names" : ["subread-order"],
+    "description" : "Align ZMWs in the order of the subread file, which then is read sequentially even if the CCS input is ordered differently. Output stays in CCS order, ZMWs waiting for their turn are spilled to OUT.bam.spill.N. Requires a PBI of the CCS input.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option ReorderBufferRecords{
+R"({
+    "names" : ["reorder-buffer-records"],
+    "description" : "Aligned records held in memory with --subread-order before waiting ZMWs are spilled.",
+    "type" : "int",
+    "default" : 200000,
+    "hidden" : true
+})"
+};
+
+const CLI_v2::Option Sorted{
+R"({
+    "names" : ["sorted"],
+    "description" : "Sort the alignments of each ZMW by position, which makes the output coordinate-sorted, and write its index, OUT.bam.bai or OUT.cram.crai.",
+    "type" : "bool"
+})"
+};
+
+const CLI_v2::Option Trace{
+R"({
+    "names" : ["trace"],
+    "description" : "Write spans of every ZMW stage in Chrome trace format to this JSON file, view in chrome://tracing or Perfetto.",
+    "type" : "string",
+    "default" : ""
+})"
+};
 // clang-format on
 }  // namespace OptionNames
+
+// Recycled input records kept per thread, about one ZMW of subreads each
+constexpr std::size_t RECORDS_PER_THREAD = 64;
+// The PBI and GZI stages of the output are light next to BAM compression,
+// one thread each keeps the compression stage within its budget
+constexpr int32_t PBI_GZI_THREADS = 1;
+
 struct ActcSettings
 {
     std::string InputCLRFile;
     std::string InputCCSFile;
     std::string OutputAlignmentFile;
     int32_t NumThreads{1};
+    ThreadBudget Threads;
+    bool PinThreads{false};
+    bool CramOutput{false};
+    bool LossyKinetics{false};
+    bool ZmwStats{false};
+    double MaxZmwSeconds{0};
+    bool SubreadOrder{false};
+    // Aligned records held in memory to restore the CCS order with --subread-order
+    int32_t ReorderBufferRecords{200'000};
+    bool Sorted{false};
+    TagFilter Tags;
     int32_t ChunkCur{-1};
     int32_t ChunkAll{-1};
     int32_t TrimFlanksBp{0};
     int32_t MinCCSLength{0};
     bool CcsQuery{false};
+    SubreadAlignerConfig AlignerConfig;
+    int32_t CheckpointInterval{0};
+    bool Resume{false};
+    // Written ZMWs after which the run fails like an interrupted one, 0 never
+    int32_t StopAfterCheckpoint{0};
+    // Inclusive hole number range, -1 if unbounded
+    int32_t MinZmw{-1};
+    int32_t MaxZmw{-1};
+};
+
+// Shared by all runs of one process, a server keeps them warm between jobs
+struct RunnerResources
+{
+    RunnerResources(const int32_t numDecompressionThreads, const int32_t numCompressionThreads,
+                    const bool persistentZmwIndex)
+        : BgzfPool{numDecompressionThreads + numCompressionThreads}
+        , NumCompressionThreads{numCompressionThreads}
+        , ZmwIndices{persistentZmwIndex}
+    {
+    }
+
+    IO::BgzfThreadPool BgzfPool;
+    // Compression threads included in the pool, for CRAM output
+    int32_t NumCompressionThreads;
+    IO::ZmwOffsetIndexCache ZmwIndices;
+};
+
+// Alignments of one CCS ZMW and the input position following it
+struct AlignedZmw
+{
+    // Position in CCS order with --subread-order, -1 otherwise
+    int32_t Rank{-1};
+    int32_t NumZmwsRead{0};
+    int32_t NextCcsIdx{0};
+    int32_t HoleNumber{-1};
+    std::vector<BAM::BamRecord> Records;
+    ZmwStats Stats;
 };
 
 CLI_v2::Interface CreateCLI()
@@ -98,28 +360,52 @@ CLI_v2::Interface CreateCLI()
         "name" : "IN.subreads.bam",
         "description" : "Subreads BAM.",
         "type" : "file",
-        "required" : true
+        "required" : false
     })"};
     const CLI_v2::PositionalArgument InputCCSFile{
         R"({
         "name" : "IN.ccs.bam",
         "description" : "CCS BAM.",
         "type" : "file",
-        "required" : true
+        "required" : false
     })"};
     const CLI_v2::PositionalArgument Output{
         R"({
         "name" : "OUT.bam",
-        "description" : "Aligned subreads to CCS BAM.",
+        "description" : "Aligned subreads to CCS BAM, or CRAM if it ends with .cram.",
         "type" : "file",
-        "required" : true
+        "required" : false
     })"};
     i.AddPositionalArguments({InputCLRFile, InputCCSFile, Output});
     i.AddOption(IO::OptionNames::Chunk);
+    i.AddOption(IO::OptionNames::BalanceChunks);
+    i.AddOption(IO::OptionNames::ZmwIndex);
 
     i.AddOption(OptionNames::CcsQuery);
     i.AddOption(OptionNames::TrimFlanksBp);
     i.AddOption(OptionNames::MinCCSLength);
+    i.AddOption(OptionNames::AutoBandwidth);
+    i.AddOption(OptionNames::PredictStrand);
+    i.AddOption(OptionNames::PrimaryOnly);
+    i.AddOption(OptionNames::CheckpointInterval);
+    i.AddOption(OptionNames::Resume);
+    i.AddOption(OptionNames::StopAfterCheckpoint);
+    i.AddOption(OptionNames::DecompressionThreads);
+    i.AddOption(OptionNames::AlignmentThreads);
+    i.AddOption(OptionNames::CompressionThreads);
+    i.AddOption(OptionNames::PinThreads);
+    i.AddOption(OptionNames::LossyKinetics);
+    i.AddOption(OptionNames::KeepTags);
+    i.AddOption(OptionNames::DropTags);
+    i.AddOption(OptionNames::StripKinetics);
+    i.AddOption(OptionNames::Serve);
+    i.AddOption(OptionNames::Zmws);
+    i.AddOption(OptionNames::Trace);
+    i.AddOption(OptionNames::ZmwStats);
+    i.AddOption(OptionNames::MaxZmwTime);
+    i.AddOption(OptionNames::SubreadOrder);
+    i.AddOption(OptionNames::ReorderBufferRecords);
+    i.AddOption(OptionNames::Sorted);
 
     const auto printVersion = [](const CLI_v2::Interface& interface) {
         const std::string actcVersion = []() {
@@ -153,13 +439,19 @@ CLI_v2::Interface CreateCLI()
     return i;
 }
 
-void WorkerThread(Parallel::WorkQueue<std::vector<BAM::BamRecord>>& queue, BAM::BamWriter& writer,
-                  const int32_t numReads)
+void WorkerThread(Parallel::WorkQueue<AlignedZmw>& queue, BAM::IRecordWriter& writer,
+                  std::ostream* zmwStats, const int32_t numReads, Checkpoint checkpoint,
+                  const std::string& checkpointFile, const int32_t stopAfterCheckpoint,
+                  ReorderBuffer* reorder, std::atomic<bool>& failed)
 {
-    int32_t counter = 0;
+    int32_t counter = checkpoint.NumZmwsWritten;
     double perc = 0;
+    if (TraceSink* trace = ActiveTrace()) {
+        trace->NameCurrentThread("writer");
+    }
 
-    auto LambdaWorker = [&](std::vector<BAM::BamRecord>&& ps) {
+    auto LambdaWorker = [&](AlignedZmw&& zmw) {
+        const TraceSpan span{"write", zmw.HoleNumber};
         ++counter;
         if (1.0 * counter / numReads > (perc + 0.001)) {
             perc = counter * 1.0 / numReads;
@@ -167,38 +459,195 @@ void WorkerThread(Parallel::WorkQueue<std::vector<BAM::BamRecord>>& queue, BAM::
             ss << std::fixed << std::setprecision(2) << 100 * perc << '%';
             PBLOG_BLOCK_INFO("Progress", ss.str());
         }
-        for (const auto& record : ps) {
+        for (const auto& record : zmw.Records) {
             writer.Write(record);
         }
+        if (zmwStats) {
+            WriteZmwStats(*zmwStats, zmw.Stats);
+        }
+
+        if (checkpoint.Interval > 0) {
+            checkpoint.NumZmwsRead = zmw.NumZmwsRead;
+            checkpoint.NextCcsIdx = zmw.NextCcsIdx;
+            checkpoint.NumRecords += zmw.Records.size();
+            if (counter % checkpoint.Interval == 0) {
+                writer.TryFlush();
+                checkpoint.NumZmwsWritten = counter;
+                checkpoint.FlushedRecords.emplace_back(checkpoint.NumRecords);
+                checkpoint.Save(checkpointFile);
+                PBLOG_BLOCK_DEBUG("Checkpoint", std::to_string(counter) + " ZMWs");
+                if (counter == stopAfterCheckpoint) {
+                    throw PB_CLI_ALARM("Stopped after the checkpoint of " +
+                                       std::to_string(counter) + " ZMWs");
+                }
+            }
+        }
+    };
+
+    // ZMWs arrive in subread order
+    const auto Reorder = [&](AlignedZmw&& zmw) {
+        reorder->Add(zmw.Rank, ZmwOutput{{}, std::move(zmw.Records), zmw.Stats});
+        ZmwOutput next;
+        while (reorder->Next(next)) {
+            AlignedZmw ordered;
+            ordered.HoleNumber = next.Stats.HoleNumber;
+            ordered.Records = std::move(next.Records);
+            ordered.Stats = next.Stats;
+            LambdaWorker(std::move(ordered));
+        }
     };
 
-    while (queue.ConsumeWith(LambdaWorker)) {
+    // After the first error, ZMWs are drained without writing them, so that
+    // producers never block on a full queue
+    std::exception_ptr error;
+    const auto Consume = [&](AlignedZmw&& zmw) {
+        if (error) {
+            return;
+        }
+        if (reorder) {
+            Reorder(std::move(zmw));
+        } else {
+            LambdaWorker(std::move(zmw));
+        }
+    };
+    while (true) {
+        try {
+            if (!queue.ConsumeWith(Consume)) {
+                break;
+            }
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+                failed = true;
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    if (reorder && reorder->NumWaiting() > 0) {
+        throw PB_CLI_ALARM(std::to_string(reorder->NumWaiting()) +
+                           " ZMWs are missing from the output order");
     }
 }
 
-void SetBamReaderDecompThreads(const int32_t numThreads)
+// Finalizes the work queue and waits for its consumer, at the latest when
+// leaving the scope
+class WorkQueueGuard
 {
-    static constexpr char BAMREADER_ENV[] = "PB_BAMREADER_THREADS";
-    const std::string decompThreads = std::to_string(numThreads);
-    setenv(BAMREADER_ENV, decompThreads.c_str(), true);
+public:
+    WorkQueueGuard(Parallel::WorkQueue<AlignedZmw>& queue, std::future<void>& consumer)
+        : queue_{queue}, consumer_{consumer}
+    {
+    }
+
+    WorkQueueGuard(const WorkQueueGuard&) = delete;
+    WorkQueueGuard& operator=(const WorkQueueGuard&) = delete;
+
+    ~WorkQueueGuard() { Finish(); }
+
+    void Finish()
+    {
+        if (finished_) {
+            return;
+        }
+        finished_ = true;
+        queue_.FinalizeWorkers();
+        consumer_.wait();
+        queue_.Finalize();
+    }
+
+private:
+    Parallel::WorkQueue<AlignedZmw>& queue_;
+    std::future<void>& consumer_;
+    bool finished_{false};
+};
+
+// Copy the records of the partial output covered by the checkpoint, flushing
+// where the interrupted run flushed to reproduce its BGZF blocks
+void ReplayCheckpoint(const Checkpoint& checkpoint, const std::string& partialFile,
+                      BAM::IRecordWriter& writer, const IO::BgzfThreadPool& bgzfPool)
+{
+    IO::PooledBamReader partial{BAM::BamFile{partialFile}, &bgzfPool};
+    BAM::BamRecord record;
+    auto nextFlush = checkpoint.FlushedRecords.cbegin();
+    for (int64_t i = 1; i <= checkpoint.NumRecords; ++i) {
+        if (!partial.GetNext(record)) {
+            throw PB_CLI_ALARM("Partial output " + partialFile + " has fewer records than its " +
+                               "checkpoint: " + std::to_string(i - 1) + " vs. " +
+                               std::to_string(checkpoint.NumRecords));
+        }
+        writer.Write(record);
+        if (nextFlush != checkpoint.FlushedRecords.cend() && *nextFlush == i) {
+            writer.TryFlush();
+            ++nextFlush;
+        }
+    }
 }
 
-int RunnerSubroutine(const CLI_v2::Results& options)
+// Returns the records of a CCS ZMW to align against, in output order. By-strand
+// ZMWs yield their forward and reverse CCS record, others exactly one record.
+// Records shorter than minCCSLength are dropped, a by-strand ZMW with one short
+// strand aligns all its passes to the other, which is reported once per ZMW by
+// the caller that passes warnOneStrand.
+std::vector<BAM::BamRecord> SelectCcsRecords(IO::ZmwRecords& zmwRecords, const int32_t minCCSLength,
+                                             const bool warnOneStrand)
 {
-    Utility::Stopwatch globalTimer;
-    SetBamReaderDecompThreads(options.NumThreads());
+    std::vector<BAM::BamRecord>& records = zmwRecords.InputRecords;
+    if (records.empty()) {
+        PBLOG_BLOCK_FATAL("CCS reader",
+                          "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) + " has no records!");
+        return {};
+    }
 
-    ActcSettings settings;
-    settings.CcsQuery = options[OptionNames::CcsQuery];
-    settings.TrimFlanksBp = options[OptionNames::TrimFlanksBp];
-    settings.MinCCSLength = options[OptionNames::MinCCSLength];
-    const std::vector<std::string> files = options.PositionalArguments();
+    if (std::ssize(records) == 2) {
+        const auto isStrand = [](const BAM::BamRecord& record, const std::string& suffix) {
+            return boost::ends_with(record.FullName(), suffix);
+        };
+        if (isStrand(records[0], "/rev") && isStrand(records[1], "/fwd")) {
+            std::swap(records[0], records[1]);
+        }
+        if (!isStrand(records[0], "/fwd") || !isStrand(records[1], "/rev")) {
+            PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
+                                                " has multiple records. Ignoring ZMW!");
+            return {};
+        }
+    } else if (std::ssize(records) != 1) {
+        PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
+                                            " has multiple records. Ignoring ZMW!");
+        return {};
+    }
+
+    std::vector<BAM::BamRecord> result;
+    for (auto& record : records) {
+        if (static_cast<int32_t>(record.Impl().SequenceLength()) < minCCSLength) {
+            PBLOG_BLOCK_DEBUG(
+                "CCS reader",
+                "CCS " + record.FullName() +
+                    " has sequence shorter than --min-ccs-length + 2 * --trim-flanks-bp!");
+            continue;
+        }
+        result.emplace_back(std::move(record));
+    }
+    if (warnOneStrand && std::ssize(records) == 2 && std::ssize(result) == 1) {
+        PBLOG_BLOCK_WARN("CCS reader", "By-strand CCS ZMW " +
+                                           std::to_string(zmwRecords.HoleNumber) +
+                                           " has one strand shorter than --min-ccs-length + 2 * "
+                                           "--trim-flanks-bp, aligning all passes to " +
+                                           result.front().FullName());
+    }
+    return result;
+}
 
+// Align the ZMWs of one chunk, files are IN.subreads.bam, IN.ccs.bam and OUT.bam
+void AlignChunk(ActcSettings settings, const std::vector<std::string>& files,
+                IO::BamZmwReaderConfig zmwReaderConfig, std::string commandLine,
+                RunnerResources& resources)
+{
     const auto ReadType = [&settings](const std::string& inputFile) {
         const auto bamFiles = BAM::DataSet(inputFile).BamFiles();
         if (bamFiles.empty()) {
-            PBLOG_BLOCK_FATAL("Input checker", "No BAM files available for: " + inputFile);
-            std::exit(EXIT_FAILURE);
+            throw PB_CLI_ALARM("No BAM files available for: " + inputFile);
         }
 
         std::string readType;
@@ -207,25 +656,19 @@ int RunnerSubroutine(const CLI_v2::Results& options)
                 if (readType.empty()) {
                     readType = rg.ReadType();
                 } else if (readType != rg.ReadType()) {
-                    PBLOG_BLOCK_FATAL(
-                        "Input checker",
+                    throw PB_CLI_ALARM(
                         "Do not mix and match different read types for input file : " + inputFile);
-                    std::exit(EXIT_FAILURE);
                 }
             }
         }
         if (readType.empty()) {
-            PBLOG_BLOCK_FATAL(
-                "Input checker",
-                "Could not determine read type, read groups are missing : " + inputFile);
-            std::exit(EXIT_FAILURE);
+            throw PB_CLI_ALARM("Could not determine read type, read groups are missing : " +
+                               inputFile);
         }
         if (readType == "CCS") {
             if (!settings.InputCCSFile.empty() && !settings.CcsQuery) {
-                PBLOG_BLOCK_FATAL("Input checker", "Multiple CCS files detected!");
-                PBLOG_BLOCK_FATAL("Input checker", "1) " + settings.InputCCSFile);
-                PBLOG_BLOCK_FATAL("Input checker", "2) " + inputFile);
-                std::exit(EXIT_FAILURE);
+                throw PB_CLI_ALARM("Multiple CCS files detected! 1) " + settings.InputCCSFile +
+                                   " 2) " + inputFile);
             }
             if (settings.InputCCSFile.empty()) {
                 settings.InputCCSFile = inputFile;
@@ -234,214 +677,477 @@ int RunnerSubroutine(const CLI_v2::Results& options)
             }
         } else if (readType == "SUBREAD") {
             if (!settings.InputCLRFile.empty()) {
-                PBLOG_BLOCK_FATAL("Input checker", "Multiple CLR files detected!");
-                PBLOG_BLOCK_FATAL("Input checker", "1) " + settings.InputCLRFile);
-                PBLOG_BLOCK_FATAL("Input checker", "2) " + inputFile);
-                std::exit(EXIT_FAILURE);
+                throw PB_CLI_ALARM("Multiple CLR files detected! 1) " + settings.InputCLRFile +
+                                   " 2) " + inputFile);
             }
             settings.InputCLRFile = inputFile;
         } else {
-            PBLOG_BLOCK_FATAL("Input checker", "Unknown read type in : " + inputFile);
-            std::exit(EXIT_FAILURE);
+            throw PB_CLI_ALARM("Unknown read type in : " + inputFile);
         }
     };
 
     ReadType(files[0]);
     ReadType(files[1]);
     settings.OutputAlignmentFile = files[2];
-    settings.NumThreads = options.NumThreads();
-
-    IO::BamZmwReaderConfig zmwReaderConfig{options};
-    const std::int32_t trimBothFlanksBp = 2 * settings.TrimFlanksBp;
-    const std::int32_t minCCSLength = settings.MinCCSLength + trimBothFlanksBp;
-
-    const auto clrFiles = BAM::DataSet(settings.InputCLRFile).BamFiles();
-    if (clrFiles.size() != 1) {
-        PBLOG_BLOCK_FATAL("Input checker", "CLR input must be exactly one BAM file! Found " +
-                                               std::to_string(clrFiles.size()));
-        std::exit(EXIT_FAILURE);
+    settings.CramOutput = boost::iends_with(settings.OutputAlignmentFile, ".cram");
+    if (settings.LossyKinetics && !settings.CramOutput) {
+        throw PB_CLI_ALARM("--lossy-kinetics requires CRAM output, OUT.cram");
     }
-
-    if (!clrFiles[0].PacBioIndexExists()) {
-        PBLOG_BLOCK_FATAL("Input checker", "Missing PBI file for " + clrFiles[0].Filename());
-        PBLOG_BLOCK_FATAL("Input checker",
-                          "Please generate one with : pbindex " + clrFiles[0].Filename());
-        PBLOG_BLOCK_FATAL("Input checker",
-                          "You can get pbindex from bioconda: conda install -c bioconda pbbam");
-        std::exit(EXIT_FAILURE);
+    if (settings.CramOutput && settings.CheckpointInterval > 0) {
+        throw PB_CLI_ALARM("--checkpoint-interval is not supported for CRAM output");
     }
-
-    std::unordered_map<int32_t, int64_t> holenumberToOffset;
-    {
-        BAM::PbiRawData pbi{clrFiles[0].PacBioIndexFilename()};
-        const int32_t numPbiRecord = pbi.BasicData().holeNumber_.size();
-        int32_t curHoleNumber = pbi.BasicData().holeNumber_[0];
-        holenumberToOffset.insert({curHoleNumber, pbi.BasicData().fileOffset_[0]});
-        for (int32_t i = 1; i < numPbiRecord; ++i) {
-            if (pbi.BasicData().holeNumber_[i] != curHoleNumber) {
-                curHoleNumber = pbi.BasicData().holeNumber_[i];
-                holenumberToOffset.insert({curHoleNumber, pbi.BasicData().fileOffset_[i]});
-            }
-        }
+    if (settings.SubreadOrder && settings.CheckpointInterval > 0) {
+        throw PB_CLI_ALARM("--checkpoint-interval is not supported with --subread-order");
     }
 
-    BAM::BamReader clrFile{clrFiles[0].Filename()};
-    {
-        auto ccsFiles = BAM::DataSet(settings.InputCCSFile).BamFiles();
-        if (ccsFiles.size() != 1) {
-            PBLOG_BLOCK_FATAL("Input checker", "Expecting exactly one CCS BAM file, found " +
-                                                   std::to_string(ccsFiles.size()));
-            std::exit(EXIT_FAILURE);
-        }
-    }
+    // All input BGZF streams share one pool, CRAM output of a CLI run compresses
+    // with it too
+    const IO::BgzfThreadPool& bgzfPool = resources.BgzfPool;
 
-    BAM::BamRecord clrRecord;
-    clrFile.GetNext(clrRecord);
+    zmwReaderConfig.SubreadFile = settings.InputCLRFile;
+    zmwReaderConfig.ThreadPool = &bgzfPool;
+    zmwReaderConfig.FilterQueryThreads = settings.Threads.Decompression;
+    zmwReaderConfig.ZmwIndices = &resources.ZmwIndices;
+    const std::int32_t trimBothFlanksBp = 2 * settings.TrimFlanksBp;
+    const std::int32_t minCCSLength = settings.MinCCSLength + trimBothFlanksBp;
+
+    // Enough recycled records for the ZMWs in flight
+    IO::RecordPool recordPool{settings.Threads.Alignment * RECORDS_PER_THREAD};
+    IO::ClrZmwReader clrReader{BAM::DataSet(settings.InputCLRFile).BamFiles(), resources.ZmwIndices,
+                               recordPool, &bgzfPool};
+
+    const auto InZmwRange = [&settings](const int32_t holeNumber) {
+        return (settings.MinZmw < 0 || holeNumber >= settings.MinZmw) &&
+               (settings.MaxZmw < 0 || holeNumber <= settings.MaxZmw);
+    };
 
-    BAM::BamHeader header = clrFile.Header().DeepCopy();
+    BAM::BamHeader header = clrReader.Header().DeepCopy();
+    std::string outputFastaName = settings.OutputAlignmentFile;
+    boost::replace_all(outputFastaName, settings.CramOutput ? ".cram" : ".bam", ".fasta");
     int32_t numCcsReads = 0;
+    int32_t numCcsZmws = 0;
+    // ZMWs to align with --subread-order, in CCS order until sorted
+    struct PlannedZmw
+    {
+        int32_t Rank;
+        int32_t FirstRefId;
+        int32_t HoleNumber;
+        std::string MovieName;
+        IO::ClrZmwReader::ZmwLocation Subreads;
+    };
+    std::vector<PlannedZmw> plan;
     {
-        std::string outputFastaName = settings.OutputAlignmentFile;
-        boost::replace_all(outputFastaName, ".bam", ".fasta");
         BAM::FastaWriter fasta{outputFastaName};
         IO::BamZmwReader ccsReader{settings.InputCCSFile, zmwReaderConfig};
 
         IO::ZmwRecords zmwRecords;
+        std::string ccsSeq;
         PBLOG_BLOCK_INFO("Fasta CCS", "Start writing CCS reads to " + outputFastaName);
         while (ccsReader.GetNext(zmwRecords)) {
             if ((numCcsReads % 10000) == 0) {
                 PBLOG_BLOCK_INFO("Fasta CCS", std::to_string(numCcsReads));
             }
-            if (zmwRecords.InputRecords.empty()) {
-                PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
-                                                    " has no records!");
+            if (!InZmwRange(zmwRecords.HoleNumber)) {
                 continue;
             }
-
-            if (std::ssize(zmwRecords.InputRecords) != 1) {
-                PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
-                                                    " has multiple records. Ignoring ZMW!");
+            const std::vector<BAM::BamRecord> ccsRecords =
+                SelectCcsRecords(zmwRecords, minCCSLength, true);
+            if (ccsRecords.empty()) {
                 continue;
             }
-
-            const auto ccsRecord = zmwRecords.InputRecords[0];
-            std::string ccsSeq = ccsRecord.Sequence();
-            std::int32_t ccsSeqLen = std::ssize(ccsSeq);
-            if (ccsSeqLen < minCCSLength) {
-                PBLOG_BLOCK_DEBUG(
-                    "CCS reader",
-                    "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
-                        " has sequence shorter than --min-ccs-length + 2 * --trim-flanks-bp!");
-                continue;
+            if (settings.SubreadOrder) {
+                const auto location = clrReader.Locate(zmwRecords.MovieName, zmwRecords.HoleNumber);
+                if (location) {
+                    plan.emplace_back(PlannedZmw{static_cast<int32_t>(plan.size()), numCcsReads,
+                                                 static_cast<int32_t>(zmwRecords.HoleNumber),
+                                                 zmwRecords.MovieName, *location});
+                } else if (!settings.CcsQuery) {
+                    throw PB_CLI_ALARM("ZMW " + std::to_string(zmwRecords.HoleNumber) +
+                                       " missing in CLR file " + settings.InputCLRFile);
+                }
             }
-            ccsSeq = ccsSeq.substr(settings.TrimFlanksBp, ccsSeqLen - trimBothFlanksBp);
-            ccsSeqLen = std::ssize(ccsSeq);
-            const std::string name = ccsRecord.FullName();
-            header.AddSequence({name, std::to_string(ccsSeqLen)});
-            fasta.Write(name, ccsSeq);
-            ++numCcsReads;
+            for (const auto& ccsRecord : ccsRecords) {
+                const int32_t ccsLength = ccsRecord.Impl().SequenceLength();
+                DecodeSequence(ccsRecord, settings.TrimFlanksBp, ccsLength - settings.TrimFlanksBp,
+                               ccsSeq);
+                const std::string name = ccsRecord.FullName();
+                header.AddSequence({name, std::to_string(ccsSeq.size())});
+                fasta.Write(name, ccsSeq);
+                ++numCcsReads;
+            }
+            ++numCcsZmws;
         }
         PBLOG_BLOCK_INFO("Fasta CCS", std::to_string(numCcsReads));
     }
 
+    const std::string checkpointFile = Checkpoint::Filename(settings.OutputAlignmentFile);
+    Checkpoint checkpoint;
+    checkpoint.Interval = settings.CheckpointInterval;
+    std::optional<Checkpoint> resumeFrom;
+    if (settings.Resume) {
+        resumeFrom = Checkpoint::Load(checkpointFile);
+        if (!resumeFrom) {
+            PBLOG_BLOCK_WARN("Checkpoint", "No checkpoint " + checkpointFile +
+                                               " found, starting from the first ZMW");
+        } else if (resumeFrom->Interval != settings.CheckpointInterval) {
+            throw PB_CLI_ALARM("--checkpoint-interval must match the interrupted run: " +
+                               std::to_string(resumeFrom->Interval));
+        } else if (!std::filesystem::exists(settings.OutputAlignmentFile) &&
+                   !std::filesystem::exists(settings.OutputAlignmentFile + ".partial")) {
+            throw PB_CLI_ALARM("Partial output missing: " + settings.OutputAlignmentFile);
+        } else {
+            checkpoint = *resumeFrom;
+        }
+    }
+
+    // A resumed run must produce the same header as an uninterrupted one
+    boost::replace_all(commandLine, " --resume", "");
     BAM::ProgramInfo program("actc");
-    program.Name("actc")
-        .CommandLine(options.InputCommandLine())
-        .Version(Actc::LibraryInfo().Release);
+    program.Name("actc").CommandLine(commandLine).Version(Actc::LibraryInfo().Release);
     header.AddProgram(program);
+    if (settings.Sorted) {
+        header.SortOrder("coordinate");
+    }
 
-    BAM::BamWriter writer(settings.OutputAlignmentFile, header, BAM::BamWriter::DefaultCompression,
-                          settings.NumThreads);
+    const std::string partialFile = settings.OutputAlignmentFile + ".partial";
+    // An earlier resume might have been interrupted while copying
+    if (resumeFrom && !std::filesystem::exists(partialFile)) {
+        std::filesystem::rename(settings.OutputAlignmentFile, partialFile);
+    }
 
-    Parallel::WorkQueue<std::vector<BAM::BamRecord>> workQueue(settings.NumThreads, 10);
-    std::future<void> workerThread = std::async(std::launch::async, WorkerThread,
-                                                std::ref(workQueue), std::ref(writer), numCcsReads);
+    // The PBI is generated while writing, this also keeps the partial output
+    // of checkpointed runs at its final path. CRAM references the CCS FASTA.
+    std::optional<IO::BgzfThreadPool> cramPool;
+    std::unique_ptr<BAM::IRecordWriter> writer;
+    IO::CramWriter* cramWriter = nullptr;
+    if (settings.CramOutput) {
+        // The pool of a server holds no compression threads, jobs bring their own
+        if (resources.NumCompressionThreads == 0) {
+            cramPool.emplace(settings.Threads.Compression);
+        }
+        auto cram = std::make_unique<IO::CramWriter>(
+            settings.OutputAlignmentFile, header, outputFastaName,
+            cramPool ? &*cramPool : &bgzfPool, settings.LossyKinetics, settings.Sorted);
+        cramWriter = cram.get();
+        writer = std::move(cram);
+    } else {
+        writer = std::make_unique<BAM::IndexedBamWriter>(
+            settings.OutputAlignmentFile, header, BAM::BamWriter::DefaultCompression,
+            settings.Threads.Compression, BAM::PbiBuilder::DefaultCompression, PBI_GZI_THREADS,
+            PBI_GZI_THREADS);
+    }
 
-    const auto Submit =
-        [&header](const std::vector<BAM::BamRecord>& clrRecords, const BAM::BamRecord& ccsRecord,
-                  const int32_t curCcsIdx, const bool ccs, const int32_t trimFlanksBp,
-                  const std::int32_t minCCSLength, const std::int32_t trimBothFlanksBp) {
-            std::vector<BAM::BamRecord> alnRecords;
+    if (resumeFrom) {
+        PBLOG_BLOCK_INFO("Checkpoint",
+                         "Resuming after " + std::to_string(checkpoint.NumZmwsWritten) +
+                             " ZMWs and " + std::to_string(checkpoint.NumRecords) + " records");
+        ReplayCheckpoint(checkpoint, partialFile, *writer, bgzfPool);
+        std::filesystem::remove(partialFile);
+    }
 
-            std::string ccsSeq = ccsRecord.Sequence();
-            std::int32_t ccsSeqLen = std::ssize(ccsSeq);
-            if (ccsSeqLen < minCCSLength) {
-                return alnRecords;
-            }
-            ccsSeq = ccsSeq.substr(trimFlanksBp, ccsSeqLen - trimBothFlanksBp);
-
-            const std::vector<AlnResults> alns = PancakeAlignerSubread(clrRecords, ccsSeq);
-            int32_t subreadIdx = 0;
-            for (const auto& aln : alns) {
-                for (const auto& a : aln) {
-                    if (a->isAligned) {
-                        alnRecords.emplace_back(
-                            AlnToBam(curCcsIdx, header, *a, clrRecords[subreadIdx], ccs));
-                    }
-                }
-                ++subreadIdx;
-            }
-            return alnRecords;
-        };
+    std::optional<CpuPinner> pinner;
+    if (settings.PinThreads) {
+        pinner.emplace();
+    }
+    std::optional<std::ofstream> zmwStats;
+    if (settings.ZmwStats) {
+        std::string zmwStatsName = settings.OutputAlignmentFile;
+        boost::replace_all(zmwStatsName, settings.CramOutput ? ".cram" : ".bam", ".zmw_stats.tsv");
+        zmwStats.emplace(zmwStatsName);
+        if (!*zmwStats) {
+            throw PB_CLI_ALARM("Could not open " + zmwStatsName);
+        }
+        WriteZmwStatsHeader(*zmwStats);
+    }
+    std::optional<ReorderBuffer> reorder;
+    if (settings.SubreadOrder) {
+        reorder.emplace(settings.OutputAlignmentFile + ".spill", header,
+                        settings.ReorderBufferRecords, &bgzfPool);
+    }
 
-    int32_t curCcsIdx = 0;
-    IO::BamZmwReader ccsReader{settings.InputCCSFile, zmwReaderConfig};
-    IO::ZmwRecords zmwRecords;
-    while (ccsReader.GetNext(zmwRecords)) {
-        if (zmwRecords.InputRecords.empty()) {
-            PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
-                                                " has no records!");
-            continue;
+    // Aligner and writer threads run from here on, nothing may throw before
+    // the guard below is in place
+    std::atomic<bool> writerFailed{false};
+    Parallel::WorkQueue<AlignedZmw> workQueue(settings.Threads.Alignment, 10);
+    std::future<void> workerThread = std::async(
+        std::launch::async, WorkerThread, std::ref(workQueue), std::ref(*writer),
+        zmwStats ? &*zmwStats : nullptr, numCcsZmws, checkpoint, std::cref(checkpointFile),
+        settings.StopAfterCheckpoint, reorder ? &*reorder : nullptr, std::ref(writerFailed));
+    // The writer only returns once the queue is finalized. If a producer
+    // throws, finalize it here, as unwinding the future waits for the writer.
+    WorkQueueGuard workQueueGuard{workQueue, workerThread};
+
+    const ZmwAlignerSettings alignerSettings{settings.Threads.Alignment,
+                                             settings.TrimFlanksBp,
+                                             settings.CcsQuery,
+                                             settings.AlignerConfig,
+                                             settings.Tags,
+                                             settings.MaxZmwSeconds,
+                                             settings.Sorted};
+    std::atomic<int32_t> numFallback{0};
+    std::atomic<int32_t> numAbandoned{0};
+    const auto Submit = [&header, &alignerSettings, &recordPool, &pinner, &numFallback,
+                         &numAbandoned](std::vector<BAM::BamRecord>& clrRecords,
+                                        std::vector<BAM::BamRecord>& ccsRecords,
+                                        const int32_t curCcsIdx, const int32_t numZmwsRead,
+                                        const int32_t rank, const int64_t queuedAt) {
+        // Worker threads are owned by the queue, they pin themselves
+        if (pinner) {
+            pinner->PinCurrentThread();
+        }
+        const int32_t holeNumber = ccsRecords[0].HoleNumber();
+        if (TraceSink* trace = ActiveTrace()) {
+            thread_local bool named = false;
+            if (!named) {
+                trace->NameCurrentThread("aligner");
+                named = true;
+            }
+            trace->AddSpan("queue wait", holeNumber, queuedAt, trace->Now());
+        }
+        ZmwInput zmw{std::move(ccsRecords), std::move(clrRecords), curCcsIdx};
+        AlignedZmw result;
+        result.Rank = rank;
+        result.HoleNumber = holeNumber;
+        result.NumZmwsRead = numZmwsRead;
+        result.NextCcsIdx = curCcsIdx + zmw.CcsRecords.size();
+        ZmwOutput output = AlignZmw(zmw, alignerSettings, &header);
+        result.Records = std::move(output.Records);
+        result.Stats = output.Stats;
+        if (output.Stats.Budget == ZmwBudget::FALLBACK) {
+            ++numFallback;
+        } else if (output.Stats.Budget == ZmwBudget::ABANDONED) {
+            ++numAbandoned;
         }
 
-        if (std::ssize(zmwRecords.InputRecords) != 1) {
-            PBLOG_BLOCK_FATAL("CCS reader", "CCS ZMW " + std::to_string(zmwRecords.HoleNumber) +
-                                                " has multiple records. Ignoring ZMW!");
-            continue;
+        // Input buffers are reused by the subread reader
+        recordPool.Release(zmw.SubreadRecords);
+        recordPool.Release(zmw.CcsRecords);
+        return result;
+    };
+
+    if (settings.SubreadOrder) {
+        // Subreads are streamed, the CCS records are looked up via their PBI
+        std::sort(plan.begin(), plan.end(), [](const PlannedZmw& a, const PlannedZmw& b) {
+            return std::tie(a.Subreads.FileIdx, a.Subreads.FileOffset) <
+                   std::tie(b.Subreads.FileIdx, b.Subreads.FileOffset);
+        });
+        IO::ClrZmwReader ccsZmwReader{BAM::DataSet(settings.InputCCSFile).BamFiles(),
+                                      resources.ZmwIndices, recordPool, &bgzfPool};
+        if (TraceSink* trace = ActiveTrace()) {
+            trace->NameCurrentThread("reader");
         }
+        for (const PlannedZmw& planned : plan) {
+            // The error is rethrown once the queue is finalized
+            if (writerFailed) {
+                break;
+            }
+            IO::ZmwRecords zmwRecords;
+            zmwRecords.MovieName = planned.MovieName;
+            zmwRecords.HoleNumber = planned.HoleNumber;
+            if (!ccsZmwReader.GetZmw(planned.MovieName, planned.HoleNumber,
+                                     zmwRecords.InputRecords)) {
+                throw PB_CLI_ALARM("ZMW " + std::to_string(planned.HoleNumber) +
+                                   " missing in the PBI of " + settings.InputCCSFile);
+            }
+            std::vector<BAM::BamRecord> ccsRecords =
+                SelectCcsRecords(zmwRecords, minCCSLength, false);
+            std::vector<BAM::BamRecord> clrRecords;
+            {
+                const TraceSpan span{"read subreads", planned.HoleNumber};
+                clrReader.GetZmw(planned.MovieName, planned.HoleNumber, clrRecords);
+            }
 
-        const auto ccsRecord = zmwRecords.InputRecords[0];
+            const TraceSpan span{"submit", planned.HoleNumber};
+            const int64_t queuedAt = ActiveTrace() ? ActiveTrace()->Now() : 0;
+            workQueue.ProduceWith(Submit, std::move(clrRecords), std::move(ccsRecords),
+                                  planned.FirstRefId, 0, planned.Rank, queuedAt);
+        }
+    } else {
+        int32_t curCcsIdx = checkpoint.NextCcsIdx;
+        int32_t numZmwsRead = 0;
+        IO::BamZmwReader ccsReader{settings.InputCCSFile, zmwReaderConfig};
+        IO::ZmwRecords zmwRecords;
+        if (TraceSink* trace = ActiveTrace()) {
+            trace->NameCurrentThread("reader");
+        }
+        while (!writerFailed && ccsReader.GetNext(zmwRecords)) {
+            if (++numZmwsRead <= checkpoint.NumZmwsRead || !InZmwRange(zmwRecords.HoleNumber)) {
+                continue;
+            }
+            std::vector<BAM::BamRecord> ccsRecords =
+                SelectCcsRecords(zmwRecords, minCCSLength, false);
+            if (ccsRecords.empty()) {
+                continue;
+            }
+            const int32_t numRefs = ccsRecords.size();
+            const auto& ccsRecord = ccsRecords[0];
 
-        PBLOG_BLOCK_DEBUG("CCS reader", ccsRecord.FullName());
-        const int32_t holeNumber = ccsRecord.HoleNumber();
-        if (clrRecord.HoleNumber() != holeNumber) {
-            if (holenumberToOffset.find(holeNumber) == holenumberToOffset.cend()) {
+            PBLOG_BLOCK_DEBUG("CCS reader", ccsRecord.FullName());
+            const int32_t holeNumber = ccsRecord.HoleNumber();
+            std::vector<BAM::BamRecord> clrRecords;
+            bool foundZmw;
+            {
+                const TraceSpan span{"read subreads", holeNumber};
+                foundZmw = clrReader.GetZmw(zmwRecords.MovieName, holeNumber, clrRecords);
+            }
+            if (!foundZmw) {
                 if (!settings.CcsQuery) {
-                    PBLOG_BLOCK_FATAL("CLR reader", "ZMW " + std::to_string(holeNumber) +
-                                                        " missing in CLR file )" +
-                                                        clrFile.Filename());
-                    std::exit(EXIT_FAILURE);
+                    throw PB_CLI_ALARM("ZMW " + std::to_string(holeNumber) +
+                                       " missing in CLR file " + settings.InputCLRFile);
                 } else {
                     PBLOG_BLOCK_WARN("CLR reader", "ZMW " + std::to_string(holeNumber) +
                                                        " missing in second file )" +
-                                                       clrFile.Filename());
-                    ++curCcsIdx;
+                                                       settings.InputCLRFile);
+                    curCcsIdx += numRefs;
                     continue;
                 }
             }
-            PBLOG_BLOCK_DEBUG("CLR parser", "SEEKING");
-            clrFile.VirtualSeek(holenumberToOffset[holeNumber]);
-            clrFile.GetNext(clrRecord);
-        }
-        std::vector<BAM::BamRecord> clrRecords;
-        do {
-            PBLOG_BLOCK_DEBUG("CLR parser", clrRecord.FullName());
-            clrRecords.emplace_back(clrRecord);
-            if (!clrFile.GetNext(clrRecord)) {
-                break;
-            }
-        } while (clrRecord.HoleNumber() == holeNumber);
 
-        workQueue.ProduceWith(Submit, std::move(clrRecords), ccsRecord, curCcsIdx,
-                              settings.CcsQuery, settings.TrimFlanksBp, minCCSLength,
-                              trimBothFlanksBp);
+            // Blocks while the queue is full, the queue wait of the worker starts here
+            const TraceSpan span{"submit", holeNumber};
+            const int64_t queuedAt = ActiveTrace() ? ActiveTrace()->Now() : 0;
+            workQueue.ProduceWith(Submit, std::move(clrRecords), std::move(ccsRecords), curCcsIdx,
+                                  numZmwsRead, -1, queuedAt);
+
+            curCcsIdx += numRefs;
+        }
+    }
+
+    workQueueGuard.Finish();
+    workerThread.get();
+    if (reorder) {
+        PBLOG_BLOCK_INFO("Reorder", std::to_string(reorder->NumSpilled()) + " ZMWs spilled");
+    }
+    if (settings.MaxZmwSeconds > 0) {
+        PBLOG_BLOCK_INFO("Time budget", std::to_string(numFallback) + " ZMWs realigned, " +
+                                            std::to_string(numAbandoned) + " ZMWs abandoned");
+    }
+    if (cramWriter) {
+        // Unlike the destructor, reports a failed flush or index
+        cramWriter->Close();
+    }
+    if (settings.CheckpointInterval > 0) {
+        std::filesystem::remove(checkpointFile);
+    }
+    if (settings.Sorted && !settings.CramOutput) {
+        // The PBI is complete once the writer is closed
+        writer.reset();
+        IO::IndexSortedBam(BAM::BamFile{settings.OutputAlignmentFile});
+    }
+}
 
-        ++curCcsIdx;
+int RunnerSubroutine(const CLI_v2::Results& options)
+{
+    Utility::Stopwatch globalTimer;
+
+    ActcSettings settings;
+    settings.NumThreads = options.NumThreads();
+    settings.Threads = SplitThreadBudget(
+        settings.NumThreads, options[OptionNames::DecompressionThreads],
+        options[OptionNames::AlignmentThreads], options[OptionNames::CompressionThreads]);
+    settings.PinThreads = options[OptionNames::PinThreads];
+    PBLOG_BLOCK_INFO("Threads", "decompression " + std::to_string(settings.Threads.Decompression) +
+                                    ", alignment " + std::to_string(settings.Threads.Alignment) +
+                                    ", compression " +
+                                    std::to_string(settings.Threads.Compression));
+
+    settings.CcsQuery = options[OptionNames::CcsQuery];
+    settings.Tags = ParseTagFilter(options[OptionNames::KeepTags], options[OptionNames::DropTags],
+                                   options[OptionNames::StripKinetics]);
+    settings.TrimFlanksBp = options[OptionNames::TrimFlanksBp];
+    settings.MinCCSLength = options[OptionNames::MinCCSLength];
+    settings.AlignerConfig.AutoBandwidth = options[OptionNames::AutoBandwidth];
+    settings.AlignerConfig.PredictStrand = options[OptionNames::PredictStrand];
+    settings.AlignerConfig.PrimaryOnly = options[OptionNames::PrimaryOnly];
+    settings.CheckpointInterval = options[OptionNames::CheckpointInterval];
+    settings.Resume = options[OptionNames::Resume];
+    settings.StopAfterCheckpoint = options[OptionNames::StopAfterCheckpoint];
+    settings.LossyKinetics = options[OptionNames::LossyKinetics];
+    settings.ZmwStats = options[OptionNames::ZmwStats];
+    settings.MaxZmwSeconds = options[OptionNames::MaxZmwTime];
+    settings.SubreadOrder = options[OptionNames::SubreadOrder];
+    settings.ReorderBufferRecords = options[OptionNames::ReorderBufferRecords];
+    settings.Sorted = options[OptionNames::Sorted];
+    const std::string zmwRange = options[OptionNames::Zmws];
+    if (!zmwRange.empty()) {
+        std::tie(settings.MinZmw, settings.MaxZmw) = ParseZmwRange(zmwRange);
+    }
+    if (settings.ReorderBufferRecords < 1) {
+        throw PB_CLI_ALARM("--reorder-buffer-records must be positive");
+    }
+    if (settings.MaxZmwSeconds < 0) {
+        throw PB_CLI_ALARM("--max-zmw-time must not be negative");
+    }
+    if (settings.StopAfterCheckpoint < 0 ||
+        (settings.StopAfterCheckpoint > 0 && settings.CheckpointInterval <= 0)) {
+        throw PB_CLI_ALARM(
+            "--stop-after-checkpoint must be positive and needs --checkpoint-interval");
+    }
+    if (settings.ZmwStats && settings.Resume) {
+        throw PB_CLI_ALARM("--zmw-stats is not supported with --resume");
+    }
+    const IO::BamZmwReaderConfig zmwReaderConfig{options};
+    const std::vector<std::string> files = options.PositionalArguments();
+
+    std::optional<TraceWriter> trace;
+    const std::string traceFile = options[OptionNames::Trace];
+    if (!traceFile.empty()) {
+        trace.emplace(traceFile);
+        SetActiveTrace(&*trace);
+    }
+
+    const std::string serveSocket = options[OptionNames::Serve];
+    if (!serveSocket.empty()) {
+        if (!files.empty()) {
+            throw PB_CLI_ALARM("--serve takes inputs and output per job, not as arguments");
+        }
+        if (settings.Resume) {
+            throw PB_CLI_ALARM("--resume is not supported with --serve");
+        }
+        if (!zmwRange.empty()) {
+            throw PB_CLI_ALARM("--zmws is set per job with --serve, as zmws=FIRST-LAST");
+        }
+        // Jobs record the command line of the equivalent CLI run
+        std::string serverCommandLine = options.InputCommandLine();
+        boost::replace_all(serverCommandLine, " --serve=" + serveSocket, "");
+        boost::replace_all(serverCommandLine, " --serve " + serveSocket, "");
+        // BAM jobs compress with threads of their own writer, the pool would
+        // oversubscribe them. CRAM jobs get a pool per job.
+        RunnerResources resources{settings.Threads.Decompression, 0,
+                                  zmwReaderConfig.PersistentZmwIndex};
+        JobServer server{serveSocket};
+        server.Serve([&](const ServerJob& job) {
+            ActcSettings jobSettings = settings;
+            jobSettings.MinZmw = job.MinZmw;
+            jobSettings.MaxZmw = job.MaxZmw;
+            IO::BamZmwReaderConfig jobReaderConfig = zmwReaderConfig;
+            std::tie(jobReaderConfig.ChunkNumerator, jobReaderConfig.ChunkDenominator) =
+                IO::DetermineChunk(job.Chunk);
+
+            std::string jobCommandLine = serverCommandLine + ' ' + job.SubreadFile + ' ' +
+                                         job.CcsFile + ' ' + job.OutputFile;
+            if (!job.Chunk.empty()) {
+                jobCommandLine += " --chunk " + job.Chunk;
+            }
+            if (job.MinZmw >= 0) {
+                jobCommandLine +=
+                    " --zmws " + std::to_string(job.MinZmw) + '-' + std::to_string(job.MaxZmw);
+            }
+            PBLOG_BLOCK_INFO("Server", "Job " + jobCommandLine);
+            AlignChunk(std::move(jobSettings), {job.SubreadFile, job.CcsFile, job.OutputFile},
+                       std::move(jobReaderConfig), std::move(jobCommandLine), resources);
+        });
+        return EXIT_SUCCESS;
     }
 
-    workQueue.FinalizeWorkers();
-    workerThread.wait();
-    workQueue.Finalize();
+    if (files.size() != 3) {
+        throw PB_CLI_ALARM("Expected IN.subreads.bam IN.ccs.bam OUT.bam");
+    }
+    const bool cramOutput = boost::iends_with(files[2], ".cram");
+    RunnerResources resources{settings.Threads.Decompression,
+                              cramOutput ? settings.Threads.Compression : 0,
+                              zmwReaderConfig.PersistentZmwIndex};
+    AlignChunk(settings, files, zmwReaderConfig, options.InputCommandLine(), resources);
 
     globalTimer.Freeze();
     PBLOG_BLOCK_INFO("Run Time", globalTimer.ElapsedTime());
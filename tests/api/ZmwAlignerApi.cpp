@@ -0,0 +1,124 @@
+// Drives the public ZmwAligner API the way an embedding program would, only
+// installed headers are included.
+//
+// Usage: zmw-aligner-api SUBREADS.bam CCS.bam OUT.bam
+//
+// Writes the aligned subreads of all single-strand CCS ZMWs to OUT.bam, checks
+// that the sink sees the ZMWs in submission order and that errors thrown by
+// the sink or for invalid settings reach the caller.
+
+#include <ZmwAligner.hpp>
+
+#include <pbbam/BamFile.h>
+#include <pbbam/BamReader.h>
+#include <pbbam/BamWriter.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace PacBio;
+
+namespace {
+
+// Same as actc --min-ccs-length
+constexpr int32_t MIN_CCS_LENGTH = 100;
+
+std::vector<ZmwInput> LoadZmws(const std::string& subreadFile, const std::string& ccsFile,
+                               BAM::BamHeader& header)
+{
+    std::map<int32_t, std::vector<BAM::BamRecord>> subreads;
+    BAM::BamRecord record;
+    BAM::BamReader subreadReader{subreadFile};
+    while (subreadReader.GetNext(record)) {
+        subreads[record.HoleNumber()].emplace_back(record);
+    }
+
+    std::vector<ZmwInput> zmws;
+    BAM::BamRecord ccs;
+    BAM::BamReader ccsReader{ccsFile};
+    while (ccsReader.GetNext(ccs)) {
+        const auto found = subreads.find(ccs.HoleNumber());
+        if (found == subreads.cend() ||
+            static_cast<int32_t>(ccs.Impl().SequenceLength()) < MIN_CCS_LENGTH) {
+            continue;
+        }
+        const int32_t refId = header.Sequences().size();
+        header.AddSequence({ccs.FullName(), std::to_string(ccs.Impl().SequenceLength())});
+        zmws.emplace_back(ZmwInput{{ccs}, found->second, refId});
+    }
+    return zmws;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " SUBREADS.bam CCS.bam OUT.bam\n";
+        return EXIT_FAILURE;
+    }
+
+    BAM::BamHeader header = BAM::BamFile{argv[1]}.Header().DeepCopy();
+    const std::vector<ZmwInput> zmws = LoadZmws(argv[1], argv[2], header);
+
+    ZmwAlignerSettings settings;
+    settings.NumThreads = 2;
+
+    int32_t numRecords = 0;
+    {
+        BAM::BamWriter writer{argv[3], header};
+        std::size_t next = 0;
+        ZmwAligner aligner{
+            settings, header, [&](ZmwOutput&& output) {
+                const int32_t expected = zmws[next++].CcsRecords[0].HoleNumber();
+                if (output.Stats.HoleNumber != expected) {
+                    throw std::runtime_error{"ZMW " + std::to_string(expected) + " out of order"};
+                }
+                for (const BAM::BamRecord& record : output.Records) {
+                    writer.Write(record);
+                    ++numRecords;
+                }
+            }};
+        for (const ZmwInput& zmw : zmws) {
+            aligner.Submit(zmw);
+        }
+        aligner.Finish();
+    }
+    std::cout << zmws.size() << " ZMWs, " << numRecords << " records\n";
+
+    // Submit must not block once the sink failed, more ZMWs than the queue
+    // holds are submitted
+    try {
+        ZmwAligner aligner{settings, std::nullopt,
+                           [](ZmwOutput&&) { throw std::runtime_error{"sink failed"}; }};
+        for (int32_t i = 0; i < 10; ++i) {
+            for (const ZmwInput& zmw : zmws) {
+                aligner.Submit(zmw);
+            }
+        }
+        aligner.Finish();
+        std::cerr << "Sink error was not rethrown\n";
+        return EXIT_FAILURE;
+    } catch (const std::runtime_error& e) {
+        std::cout << "Rethrown: " << e.what() << '\n';
+    }
+
+    // Trimmed flanks must leave part of the CCS read
+    try {
+        ZmwAlignerSettings trimAll = settings;
+        trimAll.TrimFlanksBp = (zmws.front().CcsRecords[0].Impl().SequenceLength() + 1) / 2;
+        AlignZmw(zmws.front(), trimAll, &header);
+        std::cerr << "Trimming the whole CCS read did not throw\n";
+        return EXIT_FAILURE;
+    } catch (const std::runtime_error& e) {
+        std::cout << "Rejected: " << e.what() << '\n';
+    }
+    return EXIT_SUCCESS;
+}
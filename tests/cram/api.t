@@ -0,0 +1,8 @@
+  $ ${ACTC_ZMW_ALIGNER_API} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.api.bam 2> /dev/null
+  \d+ ZMWs, 68 records (re)
+  Rethrown: sink failed
+  Rejected: Cannot trim \d+ bp from each flank of CCS read .*/ccs with length \d+ (re)
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.actc.bam --log-level WARN
+  $ samtools view tiny.actc.bam > tiny.actc.sam
+  $ samtools view tiny.api.bam | diff tiny.actc.sam -
@@ -0,0 +1,26 @@
+Simulated passes close to the insert length get a narrow band
+
+  $ ${ACTC_SIMULATE} sim --zmws 1 --insert-mean 3000 --insert-sd 0 --identity 0.99 --log-level WARN
+  $ ${ACTC} sim.subreads.bam sim.ccs.bam sim.actc.bam --auto-bandwidth --log-level DEBUG 2> sim.actc.log
+  $ test "$(grep -o 'Alignment band [0-9]*' sim.actc.log | cut -d ' ' -f 3 | sort -n | tail -n 1)" -lt 500
+  $ grep -c "Realigning" sim.actc.log
+  0
+  [1]
+
+The first pass drifts by 150 bases between a deletion and an insertion of
+equal length. The narrow band truncates it, the retry with the default band
+aligns it as a run without --auto-bandwidth does.
+
+  $ name=$(samtools view sim.subreads.bam | head -n 1 | cut -f 1)
+  $ samtools view -H sim.subreads.bam > drift.subreads.sam
+  $ samtools view sim.subreads.bam | awk -F '\t' -v OFS='\t' 'BEGIN { c["A"] = "T"; c["C"] = "G"; c["G"] = "C"; c["T"] = "A" } NR == 1 { s = $10; x = ""; for (i = 2001; i <= 2150; ++i) x = x c[substr(s, i, 1)]; $10 = substr(s, 1, 500) substr(s, 651, 1350) x substr(s, 2001) } { print }' >> drift.subreads.sam
+  $ samtools view -b -o drift.subreads.bam drift.subreads.sam
+  $ pbindex drift.subreads.bam
+
+  $ ${ACTC} drift.subreads.bam sim.ccs.bam drift.default.bam --log-level WARN
+  $ ${ACTC} drift.subreads.bam sim.ccs.bam drift.autobw.bam --auto-bandwidth --log-level DEBUG 2> drift.autobw.log
+  $ grep -c "Realigning 1 truncated alignments with the default band" drift.autobw.log
+  1
+  $ samtools view drift.default.bam | awk -v n="${name}" '$1 == n' > drift.default.sam
+  $ test -s drift.default.sam
+  $ samtools view drift.autobw.bam | awk -v n="${name}" '$1 == n' | diff drift.default.sam -
@@ -0,0 +1,35 @@
+Subreads of the by-strand ZMW in by_strand.bam, passes alternate strand and carry the sequence of their strand's CCS
+
+  $ movie=m84004_220919_222401_s1
+  $ rg=$(printf '%s//SUBREAD' ${movie} | md5sum | cut -c 1-8)
+  $ printf '@HD\tVN:1.6\tSO:unknown\tpb:5.0.0\n@RG\tID:%s\tPL:PACBIO\tDS:READTYPE=SUBREAD;BINDINGKIT=101-894-200;SEQUENCINGKIT=102-118-800;BASECALLERVERSION=5.0;FRAMERATEHZ=100.000000\tPU:%s\tPM:SEQUELII\n' ${rg} ${movie} > by_strand.subreads.sam
+  $ samtools view ${TESTDIR}"/../data/by_strand.bam" | awk -F '\t' -v OFS='\t' -v rg=${rg} '{ split($1, f, "/"); seq[f[4]] = $10; zmw = f[1] "/" f[2] } END { split(zmw, z, "/"); start = 0; for (i = 0; i < 6; ++i) { s = seq[i % 2 ? "rev" : "fwd"]; q = s; gsub(/./, "5", q); end = start + length(s); print zmw "/" start "_" end, 4, "*", 0, 255, "*", "*", 0, 0, s, q, "RG:Z:" rg, "zm:i:" z[2], "qs:i:" start, "qe:i:" end, "np:i:1", "cx:i:3", "rq:f:0.8"; start = end + 50 } }' >> by_strand.subreads.sam
+  $ samtools view -b -o by_strand.subreads.bam by_strand.subreads.sam
+  $ pbindex by_strand.subreads.bam
+
+  $ ${ACTC} by_strand.subreads.bam ${TESTDIR}"/../data/by_strand.bam" by_strand.actc.bam --log-level WARN
+  $ samtools view -H by_strand.actc.bam | grep "^@SQ" | cut -f 2 | sed 's#.*/##'
+  fwd
+  rev
+
+Every pass aligns, only to the CCS of its strand and in its orientation
+
+  $ samtools view by_strand.subreads.bam | awk '{ print $1, NR % 2 ? "fwd" : "rev" }' | sort > passes.txt
+  $ samtools view -F 0x4 by_strand.actc.bam | awk '{ n = split($3, a, "/"); print $1, a[n] }' | sort -u > strands.txt
+  $ join passes.txt strands.txt | awk '$2 != $3'
+  $ cut -d ' ' -f 1 strands.txt | sort -u | wc -l
+  6
+  $ samtools view -c -f 0x10 by_strand.actc.bam
+  0
+
+A strand shorter than --min-ccs-length is dropped with a warning, all passes align to the other
+
+  $ samtools view ${TESTDIR}"/../data/by_strand.bam" | awk '{ print length($10) }'
+  8621
+  9171
+  $ ${ACTC} by_strand.subreads.bam ${TESTDIR}"/../data/by_strand.bam" by_strand.long.bam --min-ccs-length 9000 --log-level WARN 2>&1 | grep -c "By-strand CCS ZMW 206377606 has one strand shorter than --min-ccs-length + 2 \* --trim-flanks-bp, aligning all passes to m84004_220919_222401_s1/206377606/ccs/rev"
+  1
+  $ samtools view -H by_strand.long.bam | grep "^@SQ" | cut -f 2 | sed 's#.*/##'
+  rev
+  $ samtools view -F 0x904 by_strand.long.bam | cut -f 1 | sort -u | wc -l
+  6
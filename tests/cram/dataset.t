@@ -0,0 +1,24 @@
+Split the subreads and the CCS reads into two BAM files each, before and after ZMW 20
+
+  $ half() { samtools view -H "$1"; samtools view "$1" | awk -v first="$2" '{ split($1, f, "/"); if ((f[2] < 20) == first) print }'; }
+  $ for t in clr ccs; do for i in 1 2; do half ${TESTDIR}"/../data/tiny.${t}.bam" $((2 - i)) | samtools view -b -o tiny.${t}.${i}.bam - && pbindex tiny.${t}.${i}.bam; done; done
+  $ for i in 1 2; do samtools view -c tiny.ccs.${i}.bam; done
+  3
+  3
+
+  $ dataset() { printf '<?xml version="1.0" encoding="utf-8"?>\n<pbds:%s xmlns:pbds="http://pacificbiosciences.com/PacBioDatasets.xsd" xmlns:pbbase="http://pacificbiosciences.com/PacBioBaseDataModel.xsd" MetaType="PacBio.DataSet.%s" Name="%s" Version="3.0.1">\n<pbbase:ExternalResources>\n' "$1" "$1" "$2"; for i in 1 2; do printf '<pbbase:ExternalResource MetaType="PacBio.%s" ResourceId="%s.%s.bam"/>\n' "$3" "$2" ${i}; done; printf '</pbbase:ExternalResources>\n</pbds:%s>\n' "$1"; }
+  $ dataset SubreadSet tiny.clr SubreadFile.SubreadBamFile > tiny.subreadset.xml
+  $ dataset ConsensusReadSet tiny.ccs ConsensusReadFile.ConsensusReadBamFile > tiny.consensusreadset.xml
+
+Datasets align to the same records as the single BAM files
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.single.bam --log-level WARN
+  $ samtools view tiny.single.bam > tiny.single.sam
+  $ ${ACTC} tiny.subreadset.xml tiny.consensusreadset.xml tiny.dataset.bam --log-level WARN
+  $ samtools view tiny.dataset.bam | diff tiny.single.sam -
+
+Chunks that start, end or cross at the file boundary concatenate to the unchunked output
+
+  $ for n in 2 3 4 5; do for i in $(seq 1 ${n}); do ${ACTC} tiny.subreadset.xml tiny.consensusreadset.xml tiny.chunk.${n}.${i}.bam --chunk ${i}/${n} --log-level WARN || echo "chunk ${i}/${n} failed"; done; for i in $(seq 1 ${n}); do samtools view tiny.chunk.${n}.${i}.bam; done | diff tiny.single.sam - || echo "${n} chunks differ"; done
+  $ for i in 1 2 3 4; do ${ACTC} tiny.subreadset.xml tiny.consensusreadset.xml tiny.balanced.${i}.bam --chunk ${i}/4 --balance-chunks --log-level WARN; done
+  $ for i in 1 2 3 4; do samtools view tiny.balanced.${i}.bam; done | diff tiny.single.sam -
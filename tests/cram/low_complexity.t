@@ -0,0 +1,15 @@
+Ordinary inserts keep the default seeding
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.actc.bam --log-level DEBUG 2> tiny.actc.log
+  $ samtools view -c tiny.actc.bam
+  68
+  $ grep -c "Low-complexity CCS" tiny.actc.log
+  0
+  [1]
+
+Tandem repeat inserts switch to sparse seeds and still align
+
+  $ ${ACTC_SIMULATE} repeat --zmws 5 --low-complexity 1 --log-level WARN
+  $ ${ACTC} repeat.subreads.bam repeat.ccs.bam repeat.actc.bam --log-level DEBUG 2> repeat.log
+  $ grep -q "Low-complexity CCS" repeat.log
+  $ test "$(samtools view -c -F 0x904 repeat.actc.bam)" -gt 0
@@ -0,0 +1,35 @@
+Predicting the strand does not change the strand of any primary alignment
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.actc.bam --log-level WARN
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.predict.bam --predict-strand --log-level DEBUG 2> tiny.predict.log
+  $ samtools view -F 0x904 tiny.actc.bam | cut -f 1-3 > tiny.actc.strands.txt
+  $ samtools view -F 0x904 tiny.predict.bam | cut -f 1-3 | diff tiny.actc.strands.txt -
+  $ grep -q "Strand anchor is subread" tiny.predict.log
+
+Subreads that do not map, here the complement of a pass, cannot anchor the strand
+
+  $ ${ACTC_SIMULATE} sim --zmws 1 --insert-mean 3000 --insert-sd 0 --passes 10 --log-level WARN
+  $ test "$(samtools view -c sim.subreads.bam)" -ge 5
+  $ garble() { samtools view -H sim.subreads.bam > $2.subreads.sam; samtools view sim.subreads.bam | awk -F '\t' -v OFS='\t' -v k=$1 'BEGIN { c["A"] = "T"; c["C"] = "G"; c["G"] = "C"; c["T"] = "A" } NR <= k { s = $10; x = ""; for (i = 1; i <= length(s); ++i) x = x c[substr(s, i, 1)]; $10 = x } { print }' >> $2.subreads.sam; samtools view -b -o $2.subreads.bam $2.subreads.sam && pbindex $2.subreads.bam; }
+
+The second pass anchors the strand if the first does not
+
+  $ garble 1 first
+  $ ${ACTC} first.subreads.bam sim.ccs.bam first.default.bam --log-level WARN
+  $ ${ACTC} first.subreads.bam sim.ccs.bam first.predict.bam --predict-strand --log-level DEBUG 2> first.predict.log
+  $ grep -o "Strand anchor is subread [0-9]*" first.predict.log
+  Strand anchor is subread 1
+  $ samtools view -F 0x904 first.default.bam | cut -f 1-3 > first.default.txt
+  $ test "$(wc -l < first.default.txt)" -ge 4
+  $ samtools view -F 0x904 first.predict.bam | cut -f 1-3 | diff first.default.txt -
+
+Without an anchor among the first three passes, all subreads map in both orientations
+
+  $ garble 3 three
+  $ ${ACTC} three.subreads.bam sim.ccs.bam three.default.bam --log-level WARN
+  $ ${ACTC} three.subreads.bam sim.ccs.bam three.predict.bam --predict-strand --log-level DEBUG 2> three.predict.log
+  $ grep -o "No strand anchor among the first [0-9]* subreads" three.predict.log
+  No strand anchor among the first 3 subreads
+  $ samtools view -F 0x904 three.default.bam | cut -f 1-3 > three.default.txt
+  $ test "$(wc -l < three.default.txt)" -ge 2
+  $ samtools view -F 0x904 three.predict.bam | cut -f 1-3 | diff three.default.txt -
@@ -0,0 +1,30 @@
+CCS reads in reverse ZMW order, the subreads stay sorted
+
+  $ samtools view -H ${TESTDIR}"/../data/tiny.ccs.bam" > tiny.shuffled.ccs.sam
+  $ samtools view ${TESTDIR}"/../data/tiny.ccs.bam" | tac >> tiny.shuffled.ccs.sam
+  $ samtools view -b -o tiny.shuffled.ccs.bam tiny.shuffled.ccs.sam
+  $ pbindex tiny.shuffled.ccs.bam
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" tiny.shuffled.ccs.bam tiny.shuffled.bam --log-level WARN
+  $ samtools view tiny.shuffled.bam > tiny.shuffled.sam
+
+Every ZMW that has to wait is spilled and read back
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" tiny.shuffled.ccs.bam tiny.reorder.bam --subread-order --reorder-buffer-records 1 --log-level INFO 2> tiny.reorder.log
+  $ samtools view tiny.reorder.bam | diff tiny.shuffled.sam -
+  $ test "$(grep -o '[0-9]* ZMWs spilled' tiny.reorder.log | cut -d ' ' -f 1)" -gt 0
+  $ ls tiny.reorder.bam.spill.* 2> /dev/null
+  [2]
+
+A CCS PBI that misses ZMWs of its BAM fails the run instead of blocking it
+
+  $ samtools view -H ${TESTDIR}"/../data/tiny.ccs.bam" > tiny.first.ccs.sam
+  $ samtools view ${TESTDIR}"/../data/tiny.ccs.bam" | head -n 2 >> tiny.first.ccs.sam
+  $ samtools view -b -o tiny.first.ccs.bam tiny.first.ccs.sam
+  $ pbindex tiny.first.ccs.bam
+  $ cp ${TESTDIR}"/../data/tiny.ccs.bam" tiny.stale.ccs.bam
+  $ cp tiny.first.ccs.bam.pbi tiny.stale.ccs.bam.pbi
+  $ timeout 600 ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" tiny.stale.ccs.bam tiny.stale.bam --subread-order --log-level WARN 2> tiny.stale.log
+  [1]
+  $ grep -c "missing in the PBI of tiny.stale.ccs.bam" tiny.stale.log
+  1
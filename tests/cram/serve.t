@@ -0,0 +1,40 @@
+Reference runs of the CLI, the second limited to the first ZMW
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.cli.bam --log-level WARN
+  $ hole=$(samtools view ${TESTDIR}"/../data/tiny.ccs.bam" | head -n 1 | cut -f 1 | cut -d / -f 2)
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.cli_zmw.bam --zmws "${hole}-${hole}" --log-level WARN
+
+Jobs sent to a server answer OK, a malformed job or one whose CCS ZMWs are
+missing in the subreads ERROR, without stopping the server
+
+  $ ${ACTC} --serve actc.sock --log-level WARN > server.log 2>&1 &
+  $ for i in $(seq 100); do test -S actc.sock && break; sleep 0.1; done
+  $ printf '%s\t%s\t%s\n' ${TESTDIR}"/../data/tiny.clr.bam" ${TESTDIR}"/../data/tiny.ccs.bam" tiny.served.bam > jobs.txt
+  $ printf '%s\t%s\t%s\tzmws=%s-%s\n' ${TESTDIR}"/../data/tiny.clr.bam" ${TESTDIR}"/../data/tiny.ccs.bam" tiny.served_zmw.bam "${hole}" "${hole}" >> jobs.txt
+  $ printf 'tiny.clr.bam\n' >> jobs.txt
+  $ printf '%s\t%s\t%s\n' ${TESTDIR}"/../data/single.clr.bam" ${TESTDIR}"/../data/tiny.ccs.bam" tiny.missing.bam >> jobs.txt
+  $ printf '%s\t%s\t%s\n' ${TESTDIR}"/../data/tiny.clr.bam" ${TESTDIR}"/../data/tiny.ccs.bam" tiny.served_next.bam >> jobs.txt
+  $ printf 'shutdown\n' >> jobs.txt
+  $ python3 -c "import socket, sys; s = socket.socket(socket.AF_UNIX); s.connect(sys.argv[1]); f = s.makefile('rw'); [(f.write(l), f.flush(), print(f.readline().rstrip())) for l in sys.stdin]" actc.sock < jobs.txt
+  OK
+  OK
+  ERROR * (glob)
+  ERROR *missing in CLR file* (glob)
+  OK
+  OK
+  $ wait
+  $ test -S actc.sock
+  [1]
+
+Served outputs match the CLI, their @PG holds a CLI command line
+
+  $ samtools view tiny.cli.bam > tiny.cli.sam
+  $ samtools view tiny.served.bam | diff tiny.cli.sam -
+  $ samtools view tiny.served_next.bam | diff tiny.cli.sam -
+  $ samtools view tiny.cli_zmw.bam > tiny.cli_zmw.sam
+  $ samtools view tiny.served_zmw.bam | diff tiny.cli_zmw.sam -
+  $ samtools view -H tiny.served_zmw.bam | grep "^@PG" | grep -c -e "--serve" -e "zmws="
+  0
+  [1]
+  $ samtools view -H tiny.served_zmw.bam | grep "^@PG" | grep -c -e "--zmws ${hole}-${hole}"
+  1
@@ -4,3 +4,182 @@
 
   $ samtools view tiny.actc.bam > tiny.actc.sam
   $ diff ${TESTDIR}"/../data/tiny.actc_expected.sam" tiny.actc.sam
+
+  $ test -s tiny.actc.bam.pbi
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.actc.cram  --log-level WARN
+  $ samtools view -c --reference tiny.actc.fasta tiny.actc.cram
+  68
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.strip.bam --strip-kinetics --log-level WARN
+  $ samtools view -c tiny.strip.bam
+  68
+  $ samtools view tiny.strip.bam | grep -c -P "\t(ip|pw):B"
+  0
+  [1]
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.primary.bam --primary-only --log-level WARN
+  $ samtools view -c -f 0x900 tiny.primary.bam
+  0
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.trace.bam --trace tiny.trace.json --log-level WARN
+  $ tail -n 1 tiny.trace.json
+  ]}
+  $ python3 -m json.tool tiny.trace.json > /dev/null
+  $ python3 -c "import json, sys; e = json.load(open(sys.argv[1]))['traceEvents']; print(sorted({x['name'] for x in e if x['ph'] == 'X'})); print(sorted({x['args']['name'] for x in e if x['ph'] == 'M'}))" tiny.trace.json
+  ['convert', 'decode', 'map and align', 'queue wait', 'read subreads', 'submit', 'write']
+  ['aligner', 'reader', 'writer']
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.stats.bam --zmw-stats --log-level WARN
+  $ head -n 1 tiny.stats.zmw_stats.tsv
+  hole_number\tccs_length\tsubreads\tsubreads_aligned\tbases_aligned\tmean_identity\tmap_align_ms\ttime_budget (esc)
+  $ samtools view ${TESTDIR}"/../data/tiny.ccs.bam" | awk '{ split($1, f, "/"); print f[2], length($10) }' > tiny.stats.ccs.txt
+  $ samtools view ${TESTDIR}"/../data/tiny.clr.bam" | awk '{ split($1, f, "/"); ++n[f[2]] } END { for (z in n) print z, n[z] }' > tiny.stats.subreads.txt
+  $ samtools view -F 0x104 tiny.stats.bam | awk '{ for (i = 12; i <= NF; ++i) if ($i ~ /^zm:i:/) z = substr($i, 6); if (!seen[$1]++) ++n[z]; c = $6; while (match(c, /^[0-9]+[MIDNSHP=X]/)) { if (substr(c, RLENGTH, 1) ~ /[MI=X]/) b[z] += substr(c, 1, RLENGTH - 1); c = substr(c, RLENGTH + 1) } } END { for (z in n) print z, n[z], b[z] }' > tiny.stats.aligned.txt
+  $ awk 'FNR == 1 { ++file } file == 1 { s[$1] = $2 } file == 2 { a[$1] = $2; b[$1] = $3 } file == 3 { print $1, $2, s[$1] + 0, a[$1] + 0, b[$1] + 0 }' tiny.stats.subreads.txt tiny.stats.aligned.txt tiny.stats.ccs.txt > tiny.stats.expected.txt
+  $ tail -n +2 tiny.stats.zmw_stats.tsv | cut -f 1-5 | tr '\t' ' ' | diff tiny.stats.expected.txt -
+  $ tail -n +2 tiny.stats.zmw_stats.tsv | awk -F '\t' '$6 <= 0 || $6 > 1 || $7 < 0 || $8 != "ok"'
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.order.bam --subread-order --log-level WARN
+  $ samtools view tiny.order.bam | diff tiny.actc.sam -
+  $ ls tiny.order.bam.spill.* 2> /dev/null
+  [2]
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.sorted.bam --sorted --log-level WARN
+  $ samtools view -H tiny.sorted.bam | grep -c "SO:coordinate"
+  1
+  $ test -s tiny.sorted.bam.bai
+  $ ref=$(samtools view tiny.sorted.bam | head -n 1 | cut -f 3)
+  $ test "$(samtools view -c tiny.sorted.bam "${ref}")" -eq "$(samtools view tiny.sorted.bam | cut -f 3 | grep -c -x -F "${ref}")"
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.budget.bam --max-zmw-time 1000 --zmw-stats --log-level WARN
+  $ samtools view tiny.budget.bam | diff tiny.actc.sam -
+  $ tail -n +2 tiny.budget.zmw_stats.tsv | cut -f 8 | sort -u
+  ok
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.abandon.bam --max-zmw-time 0.000001 --zmw-stats --log-level INFO 2> tiny.abandon.log
+  $ samtools view -c tiny.abandon.bam
+  0
+  $ tail -n +2 tiny.abandon.zmw_stats.tsv | cut -f 8 | sort -u
+  abandoned
+  $ grep -o "[0-9]* ZMWs realigned" tiny.abandon.log
+  0 ZMWs realigned
+  $ test "$(grep -o '[0-9]* ZMWs abandoned' tiny.abandon.log | cut -d ' ' -f 1)" -eq "$(tail -n +2 tiny.abandon.zmw_stats.tsv | wc -l)"
+
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 1 --log-level WARN
+  $ test -e tiny.ckpt.bam.checkpoint
+  [1]
+  $ mv tiny.ckpt.bam tiny.ckpt_full.bam
+  $ mv tiny.ckpt.bam.pbi tiny.ckpt_full.bam.pbi
+
+Stop a run after the checkpoint of two ZMWs and resume from what it left
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 1 --stop-after-checkpoint 2 --log-level WARN 2> tiny.ckpt.log
+  [1]
+  $ grep -c "Stopped after the checkpoint of 2 ZMWs" tiny.ckpt.log
+  1
+  $ head -n 1 tiny.ckpt.bam.checkpoint
+  actc-checkpoint 1
+  $ sed -n 2p tiny.ckpt.bam.checkpoint | cut -d ' ' -f 1,4
+  1 2
+  $ sed -n 3p tiny.ckpt.bam.checkpoint
+  2
+  $ cp tiny.ckpt.bam tiny.ckpt_stopped.bam
+  $ cp tiny.ckpt.bam.checkpoint tiny.ckpt_stopped.bam.checkpoint
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 1 --resume --log-level INFO 2> tiny.resume.log
+  $ grep -c "Resuming after 2 ZMWs" tiny.resume.log
+  1
+  $ cmp tiny.ckpt.bam tiny.ckpt_full.bam
+  $ cmp tiny.ckpt.bam.pbi tiny.ckpt_full.bam.pbi
+  $ ls tiny.ckpt.bam.partial tiny.ckpt.bam.checkpoint 2> /dev/null
+  [2]
+
+Resuming fails with another interval, a corrupt checkpoint or without the partial output
+  $ cp tiny.ckpt_stopped.bam tiny.ckpt.bam
+  $ cp tiny.ckpt_stopped.bam.checkpoint tiny.ckpt.bam.checkpoint
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 2 --resume --log-level WARN 2>&1 | grep -c "checkpoint-interval must match the interrupted run: 1"
+  1
+  $ echo "actc-checkpoint" > tiny.ckpt.bam.checkpoint
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 1 --resume --log-level WARN 2>&1 | grep -c "Corrupt checkpoint file"
+  1
+  $ cp tiny.ckpt_stopped.bam.checkpoint tiny.ckpt.bam.checkpoint
+  $ rm tiny.ckpt.bam
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.ckpt.bam --checkpoint-interval 1 --resume --log-level WARN 2>&1 | grep -c "Partial output missing"
+  1
+
+Balanced chunks together hold the same records as an unchunked run
+  $ for i in 1 2 3; do ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.balanced.${i}.bam --chunk ${i}/3 --balance-chunks --log-level WARN; done
+  $ for i in 1 2 3; do samtools view tiny.balanced.${i}.bam; done | diff tiny.actc.sam -
+
+The ZMW index is written next to the subread PBI, mapped by later runs and rebuilt once the PBI changes
+  $ cp ${TESTDIR}"/../data/tiny.clr.bam" ${TESTDIR}"/../data/tiny.clr.bam.pbi" .
+  $ ${ACTC} tiny.clr.bam "${TESTDIR}"/../data/tiny.ccs.bam tiny.zmi.bam --zmw-index --log-level INFO 2> tiny.zmi.log
+  $ samtools view tiny.zmi.bam | diff tiny.actc.sam -
+  $ test -s tiny.clr.bam.pbi.zmi
+  $ grep -c "Wrote .*tiny.clr.bam.pbi.zmi" tiny.zmi.log
+  1
+  $ ${ACTC} tiny.clr.bam "${TESTDIR}"/../data/tiny.ccs.bam tiny.zmi.bam --zmw-index --log-level DEBUG 2> tiny.zmi.log
+  $ samtools view tiny.zmi.bam | diff tiny.actc.sam -
+  $ grep -q "Mapped .*tiny.clr.bam.pbi.zmi" tiny.zmi.log
+  $ grep -c "Wrote .*tiny.clr.bam.pbi.zmi" tiny.zmi.log
+  0
+  [1]
+  $ touch tiny.clr.bam.pbi
+  $ ${ACTC} tiny.clr.bam "${TESTDIR}"/../data/tiny.ccs.bam tiny.zmi.bam --zmw-index --log-level INFO 2> tiny.zmi.log
+  $ grep -c "Wrote .*tiny.clr.bam.pbi.zmi" tiny.zmi.log
+  1
+
+Pinned threads and separate stage thread counts do not change the output
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.pinned.bam --pin-threads --decompression-threads 2 --alignment-threads 3 --compression-threads 2 --log-level WARN
+  $ samtools view tiny.pinned.bam | diff tiny.actc.sam -
+  $ test -s tiny.pinned.bam.pbi
+
+--auto-bandwidth aligns the same subreads, within the band limits, independent of threads
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.autobw.bam --auto-bandwidth -j 1 --log-level DEBUG 2> tiny.autobw.log
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.autobw_j4.bam --auto-bandwidth -j 4 --log-level WARN
+  $ samtools view tiny.autobw.bam > tiny.autobw.sam
+  $ samtools view tiny.autobw_j4.bam | diff tiny.autobw.sam -
+  $ samtools view -F 0x904 tiny.actc.bam | cut -f 1 | sort > tiny.actc.primary.txt
+  $ samtools view -F 0x904 tiny.autobw.bam | cut -f 1 | sort | diff tiny.actc.primary.txt -
+  $ grep -q "Alignment band [0-9]*, z-drop [0-9]*" tiny.autobw.log
+  $ grep -o "Alignment band [0-9]*, z-drop [0-9]*" tiny.autobw.log | awk '{ b = $3 + 0; z = int(b * 4 / 5); z = z < 100 ? 100 : (z > 400 ? 400 : z); if (b < 100 || b > 500 || $5 + 0 != z) print }'
+
+Tag filters keep the values of the surviving tags, RG, zm, qs and qe are always kept
+  $ tags() { samtools view "$1" | awk -F '\t' '{ for (i = 12; i <= NF; ++i) print $1, $3, $4, $i }' | LC_ALL=C sort; }
+  $ tags tiny.actc.bam > tiny.actc.tags.txt
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.drop.bam --drop-tags ip,pw,sn,RG --log-level WARN 2> tiny.drop.log
+  $ grep -c "Required tag RG is always kept" tiny.drop.log
+  1
+  $ cut -f 1-11 tiny.actc.sam > tiny.actc.fields.sam
+  $ samtools view tiny.drop.bam | cut -f 1-11 | diff tiny.actc.fields.sam -
+  $ tags tiny.drop.bam | cut -d ' ' -f 4 | cut -d : -f 1 | LC_ALL=C sort -u
+  RG
+  cx
+  np
+  qe
+  qs
+  rq
+  zm
+  $ grep -v -E ' (ip|pw|sn):' tiny.actc.tags.txt > tiny.drop.expected.txt
+  $ tags tiny.drop.bam | diff tiny.drop.expected.txt -
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.keep.bam --keep-tags np,zm --log-level WARN
+  $ tags tiny.keep.bam | cut -d ' ' -f 4 | cut -d : -f 1 | LC_ALL=C sort -u
+  RG
+  np
+  qe
+  qs
+  zm
+  $ grep -E ' (RG|np|qe|qs|zm):' tiny.actc.tags.txt > tiny.keep.expected.txt
+  $ tags tiny.keep.bam | diff tiny.keep.expected.txt -
+
+CRAM holds the records of the BAM output, --lossy-kinetics keeps the upper five bits of ip and pw
+  $ kinetics() { samtools view "$@" | awk -F '\t' '{ for (i = 12; i <= NF; ++i) if ($i ~ /^(ip|pw):B:C,/) print $1, $3, $4, $i }'; }
+  $ samtools view --reference tiny.actc.fasta tiny.actc.cram | cut -f 1-11 | diff tiny.actc.fields.sam -
+  $ kinetics tiny.actc.bam > tiny.actc.kinetics.txt
+  $ test -s tiny.actc.kinetics.txt
+  $ kinetics --reference tiny.actc.fasta tiny.actc.cram | diff tiny.actc.kinetics.txt -
+  $ ${ACTC} ${TESTDIR}"/../data/tiny.clr.bam" "${TESTDIR}"/../data/tiny.ccs.bam tiny.lossy.cram --lossy-kinetics --log-level WARN
+  $ samtools view --reference tiny.lossy.fasta tiny.lossy.cram | cut -f 1-11 | diff tiny.actc.fields.sam -
+  $ awk '{ n = split(substr($4, 8), v, ","); s = substr($4, 1, 7); for (j = 1; j <= n; ++j) s = s (j > 1 ? "," : "") (v[j] - v[j] % 8 + 4); print $1, $2, $3, s }' tiny.actc.kinetics.txt > tiny.lossy.expected.txt
+  $ kinetics --reference tiny.lossy.fasta tiny.lossy.cram | diff tiny.lossy.expected.txt -
+  $ cmp -s tiny.actc.kinetics.txt tiny.lossy.expected.txt
+  [1]